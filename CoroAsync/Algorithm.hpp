@@ -0,0 +1,70 @@
+﻿# pragma once
+
+# include <chrono>
+# include <functional>
+# include <iterator>
+# include <memory>
+# include <ranges>
+# include <vector>
+# include <algorithm>
+# include <cstddef>
+# include "Task.hpp"
+# include "Utility.hpp"
+# include "ThreadPoolExecutor.hpp"
+
+/// @brief CoroAsync
+namespace cra
+{
+	/// @brief 範囲の各要素に関数を適用するタスクを作成します。
+	/// @remark 要素はまとめて処理され、処理にかかった時間が `budget` に達するたびに `co_await 0` でタスクキューに処理を譲ります。
+	/// 1回にまとめて処理する要素の数は、それまでの処理時間から、譲るまでの時間が `budget` に収まるように調整されます。時刻を確認するのは、まとめて処理するたびに1回だけです。
+	/// @remark 処理時間は、タスクキューの時刻の方法にかかわらず `TaskQueue::Clock` で測ります。
+	/// @remark 処理を譲るときにタスクがキャンセルされていれば、 `OperationCanceled` を投げて終了します。
+	/// @remark 範囲は、作成したタスクが完了するか破棄されるまで有効にしておいてください。
+	/// @param range 範囲
+	/// @param function 範囲の要素を引数にとる関数
+	/// @param budget 処理を譲るまでに続けて処理する時間の目安
+	/// @return 作成したタスク
+	template <std::ranges::input_range Range, class Function>
+		requires std::invocable<Function&, std::ranges::range_reference_t<Range>>
+	Task<> ForEachAsync(Range& range, Function function, TaskQueue::Clock::duration budget = std::chrono::milliseconds{ 1 });
+
+	/// @brief 範囲の各要素に関数を適用した結果を、出力イテレータに順に書き込むタスクを作成します。
+	/// @remark `ForEachAsync` と同じく、処理にかかった時間が `budget` に達するたびにタスクキューに処理を譲ります。
+	/// @remark 範囲と出力先は、作成したタスクが完了するか破棄されるまで有効にしておいてください。
+	/// @param range 範囲
+	/// @param out 出力イテレータ
+	/// @param function 範囲の要素を引数にとる関数
+	/// @param budget 処理を譲るまでに続けて処理する時間の目安
+	/// @return 最後に書き込んだ位置の次を指す出力イテレータを結果とするタスク
+	template <std::ranges::input_range Range, std::weakly_incrementable Out, class Function>
+		requires std::indirectly_writable<Out, std::invoke_result_t<Function&, std::ranges::range_reference_t<Range>>>
+	Task<Out> TransformAsync(Range& range, Out out, Function function, TaskQueue::Clock::duration budget = std::chrono::milliseconds{ 1 });
+
+	/// @brief 範囲の各要素に関数を適用する処理を、スレッドプールで並列に行うタスクを作成します。
+	/// @remark 範囲はワーカースレッドの数の数倍のブロックに分けられ、ブロックごとに `RunOnPool` で呼び出されます。呼び出し元のタスクはすべてのブロックが終わるまで中断するので、タスクキューは止まりません。
+	/// @remark 関数は複数のスレッドから同時に、異なる要素に対して呼び出されます。そうしても安全な関数の場合にのみ使ってください。
+	/// @remark 関数が例外を投げた場合は、すべてのブロックが終わった後に、その例外を投げます。
+	/// @remark 作成したタスクが破棄されても、処理中のブロックは最後まで実行されます。範囲はそれまで有効にしておいてください。
+	/// @param pool 関数を呼び出すスレッドプール
+	/// @param range 範囲
+	/// @param function 範囲の要素を引数にとる関数
+	/// @return 作成したタスク
+	template <std::ranges::random_access_range Range, class Function>
+		requires std::invocable<Function&, std::ranges::range_reference_t<Range>>
+	Task<> ForEachAsync(ThreadPoolExecutor& pool, Range& range, Function function);
+
+	/// @brief 範囲の各要素に関数を適用した結果を出力イテレータに書き込む処理を、スレッドプールで並列に行うタスクを作成します。
+	/// @remark `ForEachAsync` のスレッドプールを使う版と同じく、ブロックごとにスレッドプールで処理します。
+	/// @remark 範囲と出力先は、作成したタスクが完了するか、破棄された後で処理中のブロックが終わるまで有効にしておいてください。
+	/// @param pool 関数を呼び出すスレッドプール
+	/// @param range 範囲
+	/// @param out 範囲と同じ数の要素を書き込めるランダムアクセスイテレータ
+	/// @param function 範囲の要素を引数にとる関数
+	/// @return 最後に書き込んだ位置の次を指すイテレータを結果とするタスク
+	template <std::ranges::random_access_range Range, std::random_access_iterator Out, class Function>
+		requires std::indirectly_writable<Out, std::invoke_result_t<Function&, std::ranges::range_reference_t<Range>>>
+	Task<Out> TransformAsync(ThreadPoolExecutor& pool, Range& range, Out out, Function function);
+}
+
+# include "detail/Algorithm.ipp"
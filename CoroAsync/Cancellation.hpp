@@ -0,0 +1,124 @@
+﻿# pragma once
+
+# include <exception>
+# include <utility>
+# include "TaskQueue.hpp"
+
+/// @brief CoroAsync
+namespace cra
+{
+	template <class Type>
+	class Task;
+
+	namespace detail
+	{
+		class SetCancellationTokenAwaiter;
+	}
+
+	/// @brief キャンセルされたタスクの co_await 式が投げる例外
+	class OperationCanceled : public std::exception
+	{
+	public:
+		/// @brief 例外の説明を返します。
+		/// @return 例外の説明
+		[[nodiscard]]
+		const char* what() const noexcept override;
+	};
+
+	/// @brief キャンセル要求を受け取るためのトークン
+	/// @remark `CancellationSource` から取得し、 `Task::setCancellationToken` か `co_await SetCancellationToken(token)` でタスクに結びつけます。
+	/// @remark タスクキューの実行中のタスクが作成したタスクには、そのタスクのトークンが自動的に結びつけられます。
+	/// @remark キャンセルされたタスクは、スリープ中や別のタスクの完了待ち、 `AsyncMutex` などの待機中であればすぐに再開され、その co_await 式と以降の co_await 式が `OperationCanceled` を投げます。
+	/// 完了を待っていたタスクもキャンセルされます。
+	/// @remark スレッドセーフではありません。同じスレッドのタスクキューのタスクからのみ使用してください。スレッドプールなどで実行中のタスクはキャンセルされません。
+	class CancellationToken
+	{
+	public:
+		/// @brief キャンセルされることのないトークンを作成します。
+		[[nodiscard]]
+		CancellationToken() noexcept = default;
+
+		/// @brief コピーコンストラクタ。同じキャンセル要求を共有します。
+		/// @param other コピー元
+		[[nodiscard]]
+		CancellationToken(const CancellationToken& other) noexcept;
+
+		/// @brief ムーブコンストラクタ。
+		/// @param other ムーブ元
+		[[nodiscard]]
+		CancellationToken(CancellationToken&& other) noexcept;
+
+		/// @brief デストラクタ
+		~CancellationToken();
+
+		/// @brief コピー代入演算子。同じキャンセル要求を共有します。
+		/// @param other コピー元
+		/// @return *this
+		CancellationToken& operator =(const CancellationToken& other) noexcept;
+
+		/// @brief ムーブ代入演算子。
+		/// @param other ムーブ元
+		/// @return *this
+		CancellationToken& operator =(CancellationToken&& other) noexcept;
+
+		/// @brief キャンセルが要求されたかを返します。
+		/// @return キャンセルが要求されていれば true
+		[[nodiscard]]
+		bool isCancellationRequested() const noexcept;
+
+		/// @brief キャンセルされうるトークンかを返します。
+		/// @return `CancellationSource` から取得したトークンであれば true
+		[[nodiscard]]
+		bool canBeCanceled() const noexcept;
+
+	private:
+		friend class CancellationSource;
+		template <class Type>
+		friend class Task;
+		friend class detail::SetCancellationTokenAwaiter;
+
+		detail::CancellationState* m_state = nullptr;
+
+		[[nodiscard]]
+		explicit CancellationToken(detail::CancellationState* state) noexcept;
+	};
+
+	/// @brief キャンセルを要求するためのクラス
+	/// @remark `token` で取得したトークンを結びつけたタスクを、 `cancel` でまとめてキャンセルします。
+	/// @remark スレッドセーフではありません。同じスレッドのタスクキューのタスクからのみ使用してください。
+	class CancellationSource
+	{
+	public:
+		/// @brief キャンセルされていない状態で作成します。
+		[[nodiscard]]
+		CancellationSource();
+
+		/// @brief コピーコンストラクタ。コピー不可です。
+		CancellationSource(const CancellationSource&) = delete;
+
+		/// @brief デストラクタ。キャンセルは要求しません。
+		~CancellationSource();
+
+		/// @brief コピー代入演算子。コピー不可です。
+		CancellationSource& operator =(const CancellationSource&) = delete;
+
+		/// @brief キャンセル要求を受け取るためのトークンを返します。
+		/// @return トークン
+		[[nodiscard]]
+		CancellationToken token() const noexcept;
+
+		/// @brief キャンセルを要求します。
+		/// @remark トークンを結びつけたタスクのうち、スリープ中や待機中のものは、タスクキューの実行待ちになります。
+		void cancel();
+
+		/// @brief キャンセルが要求されたかを返します。
+		/// @return キャンセルが要求されていれば true
+		[[nodiscard]]
+		bool isCancellationRequested() const noexcept;
+
+	private:
+		detail::CancellationState* m_state;
+	};
+}
+
+# include "detail/Cancellation.ipp"
@@ -0,0 +1,125 @@
+﻿# pragma once
+
+# include <cstddef>
+# include <deque>
+# include <memory>
+# include <optional>
+# include <span>
+# include <utility>
+# include "Sync.hpp"
+
+/// @brief CoroAsync
+namespace cra
+{
+	template <class Type>
+	class Channel;
+
+	namespace detail
+	{
+		template <class Type>
+		class ChannelSendAwaiter;
+
+		template <class Type>
+		class ChannelReceiverBase;
+
+		template <class Type>
+		class ChannelReceiveAwaiter;
+
+		template <class Type>
+		class ChannelReceiveManyAwaiter;
+	}
+
+	/// @brief タスク間で値を受け渡す、容量に上限のあるチャネル
+	/// @remark 送信はチャネルが満杯のとき、受信はチャネルが空のときにタスクを中断します。中断したタスクはタスクキューに入らずに待機し、相手側の操作によって直接タスクキューに追加されます。
+	/// @remark 値はリングバッファか、待っている相手の awaiter へ直接ムーブされます。値ごとのメモリ確保は行いません。
+	/// @remark 値を受け取った後、再開する前に受信側のタスクが破棄された場合、その値は次に待っている受信側に渡されるか、次に受信される値としてチャネルに戻されます。
+	/// @remark スレッドセーフではありません。同じスレッドのタスクキューのタスクからのみ使用してください。チャネルは、待っているタスクより後に破棄してください。
+	/// @tparam Type 値の型
+	template <class Type>
+	class Channel
+	{
+	public:
+		/// @brief チャネルを作成します。
+		/// @param capacity バッファに保持できる値の数。 0 の場合は、送信側と受信側がそろうまでどちらも待ちます。
+		[[nodiscard]]
+		explicit Channel(std::size_t capacity);
+
+		/// @brief コピーコンストラクタ。コピー不可です。
+		Channel(const Channel&) = delete;
+
+		/// @brief デストラクタ。バッファに残っている値を破棄します。
+		~Channel();
+
+		/// @brief コピー代入演算子。コピー不可です。
+		Channel& operator =(const Channel&) = delete;
+
+		/// @brief 値を送信する awaiter を返します。
+		/// @remark co_await 式のオペランドに渡すと、値をバッファか待っている受信側に渡せるまでタスクを中断します。
+		/// @remark co_await 式の結果は、送信できた場合は true 、チャネルが閉じられていた場合は false です。
+		/// @remark 待っている間にタスクがキャンセルされても、その前に値が受信側に渡っていれば、 `OperationCanceled` を投げずに true を返します。
+		/// @param value 送信する値
+		/// @return awaiter
+		[[nodiscard]]
+		detail::ChannelSendAwaiter<Type> send(Type value);
+
+		/// @brief 値を受信する awaiter を返します。
+		/// @remark co_await 式のオペランドに渡すと、値を受け取れるまでタスクを中断します。
+		/// @remark co_await 式の結果は、受け取った値です。チャネルが閉じられ、残っている値もなければ std::nullopt です。
+		/// @return awaiter
+		[[nodiscard]]
+		detail::ChannelReceiveAwaiter<Type> receive() noexcept;
+
+		/// @brief 複数の値をまとめて受信する awaiter を返します。
+		/// @remark co_await 式のオペランドに渡すと、少なくとも1つの値を受け取れるまでタスクを中断し、その時点で受け取れるだけの値を out の先頭から格納します。
+		/// @remark co_await 式の結果は、格納した値の数です。チャネルが閉じられ、残っている値もなければ 0 です。
+		/// @param out 値を格納する範囲
+		/// @return awaiter
+		[[nodiscard]]
+		detail::ChannelReceiveManyAwaiter<Type> receiveMany(std::span<Type> out) noexcept;
+
+		/// @brief チャネルを閉じます。
+		/// @remark 以降の送信は失敗します。バッファに残っている値は受信できます。
+		/// @remark 待っている送信側のタスクは送信に失敗し、待っている受信側のタスクは std::nullopt を受け取って再開します。
+		void close();
+
+		/// @brief チャネルが閉じられているかを返します。
+		/// @return 閉じられていれば true
+		[[nodiscard]]
+		bool isClosed() const noexcept;
+
+		/// @brief チャネルに保持されている値の数を返します。
+		/// @remark 受信側から戻された値を含みます。
+		/// @return チャネルに保持されている値の数
+		[[nodiscard]]
+		std::size_t size() const noexcept;
+
+		/// @brief バッファに保持できる値の数を返します。
+		/// @return バッファに保持できる値の数
+		[[nodiscard]]
+		std::size_t capacity() const noexcept;
+
+	private:
+		friend class detail::ChannelSendAwaiter<Type>;
+		friend class detail::ChannelReceiverBase<Type>;
+		friend class detail::ChannelReceiveAwaiter<Type>;
+		friend class detail::ChannelReceiveManyAwaiter<Type>;
+
+		Type* m_buffer;
+		std::size_t m_capacity;
+		std::size_t m_head = 0;
+		std::size_t m_size = 0;
+		std::deque<Type> m_returned;
+		detail::SyncWaitList m_senders;
+		detail::SyncWaitList m_receivers;
+		bool m_closed = false;
+
+		bool offer(Type& value);
+
+		void giveBack(Type&& value);
+
+		template <class Sink>
+		bool take(Sink&& sink);
+	};
+}
+
+# include "detail/Channel.ipp"
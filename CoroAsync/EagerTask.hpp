@@ -0,0 +1,44 @@
+﻿# pragma once
+
+# include <coroutine>
+# include <type_traits>
+# include <utility>
+# include "Task.hpp"
+
+/// @brief CoroAsync
+namespace cra
+{
+	/// @brief 作成したその場で実行を始めるタスク
+	/// @remark コルーチンの戻り値に指定して使用します。 `Task` と異なり、タスクキューを経由せずに、作成したスレッドで最初に中断するまで実行されます。
+	/// 中断せずに完了した場合は、タスクキューを一度も通らずに結果を取得できます。キャッシュに当たった場合などにすぐ完了する処理に使います。
+	/// @remark 中断した後は `Task` と同じく、作成したスレッドのタスクキューもしくはスケジューラで再開されます。
+	/// @remark 最初に中断するまでの実行は、作成したタスクの実行として扱われます。トレースでも、作成したタスクの実行時間に含まれます。
+	/// @remark `Task<Type>` から派生しているので、 `Task<Type>` として co_await したり、 `WhenAll` などに渡したりできます。
+	/// @tparam Type 非同期処理するコルーチンの戻り値の型
+	template <class Type = void>
+	class [[nodiscard]] EagerTask : public Task<Type>
+	{
+	public:
+		/// @brief デフォルトコンストラクタ。コルーチンを結びつけずに初期化します。
+		[[nodiscard]]
+		EagerTask() noexcept = default;
+
+		/// @brief ムーブコンストラクタ
+		/// @param other ムーブするタスク
+		[[nodiscard]]
+		EagerTask(EagerTask&& other) noexcept = default;
+
+		/// @brief ムーブ代入演算子
+		/// @param other ムーブするタスク
+		/// @return *this
+		EagerTask& operator =(EagerTask&& other) noexcept = default;
+
+		class promise_type;
+
+	private:
+		[[nodiscard]]
+		explicit EagerTask(typename Task<Type>::promise_type* promise) noexcept;
+	};
+}
+
+# include "detail/EagerTask.ipp"
@@ -0,0 +1,200 @@
+﻿# pragma once
+
+# include <coroutine>
+# include <exception>
+# include <iterator>
+# include <system_error>
+# include <type_traits>
+# include <utility>
+# include <cstddef>
+# include "Task.hpp"
+
+/// @brief CoroAsync
+namespace cra
+{
+	namespace detail
+	{
+		template <class Derived, class Type>
+		class GeneratorPromiseBase;
+
+		template <class Type>
+		class AsyncGeneratorNextAwaiter;
+	}
+
+	/// @brief co_yield で値を順に生成するクラス
+	/// @remark コルーチンの戻り値に指定して使用します。範囲 for 文で値を取り出すたびに、次の co_yield までコルーチンが実行されます。
+	/// @remark 値は co_yield に渡されたオブジェクトへの参照として取り出され、値ごとのメモリ確保やコピーは行いません。 const 左辺値を co_yield した場合のみ、コピーします。
+	/// @remark コルーチン内では co_await を使えません。待機が必要な場合は `AsyncGenerator` を使用してください。
+	/// @tparam Type 生成する値の型
+	template <class Type>
+	class [[nodiscard]] Generator
+	{
+	public:
+		/// @brief 生成する値の型
+		using value_type = std::remove_cvref_t<Type>;
+
+		/// @brief 取り出す値の参照型
+		using reference = std::remove_reference_t<Type>&;
+
+		/// @brief 取り出す値のポインタ型
+		using pointer = std::remove_reference_t<Type>*;
+
+		class promise_type;
+
+		/// @brief 生成される値を順に指す入力イテレータ
+		class iterator
+		{
+		public:
+			using iterator_concept = std::input_iterator_tag;
+			using difference_type = std::ptrdiff_t;
+			using value_type = Generator::value_type;
+
+			/// @brief 終端と等しいイテレータを作成します。
+			[[nodiscard]]
+			iterator() noexcept = default;
+
+			/// @brief 現在の値を返します。
+			/// @return 現在の値
+			[[nodiscard]]
+			reference operator *() const noexcept;
+
+			/// @brief 現在の値へのポインタを返します。
+			/// @return 現在の値へのポインタ
+			[[nodiscard]]
+			pointer operator ->() const noexcept;
+
+			/// @brief 次の co_yield までコルーチンを実行します。
+			/// @remark コルーチンが例外で終了した場合、その例外を再送出します。
+			/// @return *this
+			iterator& operator ++();
+
+			/// @brief 次の co_yield までコルーチンを実行します。
+			void operator ++(int);
+
+			/// @brief 終端に達したかを返します。
+			/// @return コルーチンが終了していれば true
+			[[nodiscard]]
+			friend bool operator ==(const iterator& it, std::default_sentinel_t) noexcept
+			{
+				return (not it.m_coro) || it.m_coro.done();
+			}
+
+		private:
+			friend class Generator;
+
+			std::coroutine_handle<promise_type> m_coro = nullptr;
+
+			[[nodiscard]]
+			explicit iterator(std::coroutine_handle<promise_type> coro) noexcept;
+		};
+
+		/// @brief デフォルトコンストラクタ。コルーチンを結びつけずに初期化します。
+		[[nodiscard]]
+		Generator() noexcept;
+
+		/// @brief コピーコンストラクタ。コピー不可です。
+		Generator(const Generator&) = delete;
+
+		/// @brief ムーブコンストラクタ。
+		[[nodiscard]]
+		Generator(Generator&& other) noexcept;
+
+		/// @brief デストラクタ。コルーチンを破棄します。
+		~Generator();
+
+		/// @brief コピー代入演算子。コピー不可です。
+		Generator& operator =(const Generator&) = delete;
+
+		/// @brief ムーブ代入演算子。
+		Generator& operator =(Generator&& other) noexcept;
+
+		/// @brief 最初の co_yield までコルーチンを実行し、その値を指すイテレータを返します。
+		/// @remark 1オブジェクトにつき1回しか呼び出せません。
+		/// @remark コルーチンが例外で終了した場合、その例外を再送出します。
+		/// @return 先頭のイテレータ
+		[[nodiscard]]
+		iterator begin();
+
+		/// @brief 終端を表す番兵を返します。
+		/// @return 終端を表す番兵
+		[[nodiscard]]
+		std::default_sentinel_t end() const noexcept;
+
+	private:
+		using Handle = std::coroutine_handle<promise_type>;
+
+		Handle m_coro;
+
+		[[nodiscard]]
+		explicit Generator(Handle h) noexcept;
+	};
+
+	/// @brief co_yield で値を順に生成し、その間に co_await で待機もできるクラス
+	/// @remark コルーチンの戻り値に指定して使用します。コルーチン内では `Task` と同様に、時間や別のタスクなどを co_await できます。
+	/// @remark タスクから `co_await generator.next()` で値を取り出します。取り出すタスクと生成するコルーチンは、タスクキューを経由せずに対称転送で切り替わります。
+	/// @remark 値は co_yield に渡されたオブジェクトへの参照として取り出され、値ごとのメモリ確保やコピーは行いません。 const 左辺値を co_yield した場合のみ、コピーします。
+	/// @remark タスクキューのタスクからのみ使用できます。
+	/// @tparam Type 生成する値の型
+	template <class Type>
+	class [[nodiscard]] AsyncGenerator
+	{
+	public:
+		/// @brief 生成する値の型
+		using value_type = std::remove_cvref_t<Type>;
+
+		/// @brief 取り出す値の参照型
+		using reference = std::remove_reference_t<Type>&;
+
+		/// @brief 取り出す値のポインタ型
+		using pointer = std::remove_reference_t<Type>*;
+
+		class promise_type;
+
+		/// @brief デフォルトコンストラクタ。コルーチンを結びつけずに初期化します。
+		[[nodiscard]]
+		AsyncGenerator() noexcept;
+
+		/// @brief コピーコンストラクタ。コピー不可です。
+		AsyncGenerator(const AsyncGenerator&) = delete;
+
+		/// @brief ムーブコンストラクタ。
+		[[nodiscard]]
+		AsyncGenerator(AsyncGenerator&& other) noexcept;
+
+		/// @brief デストラクタ。コルーチンを破棄します。
+		~AsyncGenerator();
+
+		/// @brief コピー代入演算子。コピー不可です。
+		AsyncGenerator& operator =(const AsyncGenerator&) = delete;
+
+		/// @brief ムーブ代入演算子。
+		AsyncGenerator& operator =(AsyncGenerator&& other) noexcept;
+
+		/// @brief 次の値を取り出す awaiter を返します。
+		/// @remark co_await 式のオペランドに渡すと、次の co_yield までコルーチンを実行します。
+		/// @remark co_await 式の結果は、生成された値へのポインタです。ポインタは、次に値を取り出すまで有効です。コルーチンが終了していれば nullptr です。
+		/// @remark コルーチンが例外で終了した場合、 co_await 式がその例外を再送出します。
+		/// @remark 同時に複数のタスクから値を取り出すことはできません。
+		/// @return awaiter
+		[[nodiscard]]
+		detail::AsyncGeneratorNextAwaiter<Type> next() noexcept;
+
+		/// @brief コルーチンが終了したかを返します。
+		/// @return コルーチンが終了していれば true
+		[[nodiscard]]
+		bool isDone() const noexcept;
+
+		/// @brief コルーチンを破棄します。
+		void destroy() noexcept;
+
+	private:
+		using Handle = std::coroutine_handle<promise_type>;
+
+		Handle m_coro;
+
+		[[nodiscard]]
+		explicit AsyncGenerator(Handle h) noexcept;
+	};
+}
+
+# include "detail/Generator.ipp"
@@ -0,0 +1,98 @@
+﻿# pragma once
+
+# include <chrono>
+# include <coroutine>
+# include <algorithm>
+# include <cstdint>
+# include "Task.hpp"
+
+/// @brief CoroAsync
+namespace cra
+{
+	class Interval;
+
+	namespace detail
+	{
+		class IntervalAwaiter;
+	}
+
+	/// @brief `Interval` で、予定の時刻に間に合わなかった tick の扱い
+	enum class MissedTickBehavior : std::uint8_t
+	{
+		/// @brief 間に合わなかった tick を、予定の時刻に追いつくまで続けて発生させます。
+		Burst,
+
+		/// @brief 間に合わなかった tick を1回にまとめ、以降は元の予定の時刻に合わせます。
+		Skip,
+
+		/// @brief 間に合わなかった tick を1回にまとめ、以降はその時点から周期を数え直します。
+		Delay,
+	};
+
+	/// @brief 一定の周期でタスクを再開させるタイマー
+	/// @remark `co_await interval.next()` で、次の tick の予定の時刻までタスクをスリープさせます。
+	/// @remark 予定の時刻は、最初の tick の時刻に周期を足していく絶対時刻で管理されます。 `co_await period` を繰り返す場合と異なり、処理にかかった時間や再開の遅れで周期がずれません。
+	/// @remark 予定の時刻を過ぎてから `next()` を co_await した場合は、スリープせずに実行待ちキューの末尾に移ってから再開します。
+	/// @remark スリープの終了時刻は、タスクキューの現在時刻（スレッドプールで実行されるタスクは `TaskQueue::Clock::now()` ）を基準にします。
+	class Interval
+	{
+	public:
+		/// @brief 周期の型
+		using Duration = TaskQueue::Clock::duration;
+
+		/// @brief 時刻の型
+		using TimePoint = TaskQueue::TimePoint;
+
+		/// @brief 最初に `next()` を co_await した時刻から数えて、周期ごとに tick を発生させるタイマーを作成します。
+		/// @param period 周期。 0 以下の場合は、クロックの最小単位
+		/// @param behavior 予定の時刻に間に合わなかった tick の扱い
+		[[nodiscard]]
+		explicit Interval(Duration period, MissedTickBehavior behavior = MissedTickBehavior::Skip) noexcept;
+
+		/// @brief 最初の tick の時刻を指定して、周期ごとに tick を発生させるタイマーを作成します。
+		/// @param start 最初の tick の予定の時刻
+		/// @param period 周期。 0 以下の場合は、クロックの最小単位
+		/// @param behavior 予定の時刻に間に合わなかった tick の扱い
+		[[nodiscard]]
+		Interval(const TimePoint& start, Duration period, MissedTickBehavior behavior = MissedTickBehavior::Skip) noexcept;
+
+		/// @brief 次の tick までタスクをスリープさせる awaiter を返します。
+		/// @remark co_await 式は、その tick の予定の時刻を返します。
+		/// @return awaiter
+		[[nodiscard]]
+		detail::IntervalAwaiter next() noexcept;
+
+		/// @brief 次に `next()` を co_await した時刻から、周期を数え直します。
+		void reset() noexcept;
+
+		/// @brief 周期を返します。
+		/// @return 周期
+		[[nodiscard]]
+		Duration getPeriod() const noexcept;
+
+		/// @brief 予定の時刻に間に合わなかった tick の扱いを設定します。
+		/// @param behavior 予定の時刻に間に合わなかった tick の扱い
+		void setMissedTickBehavior(MissedTickBehavior behavior) noexcept;
+
+		/// @brief 予定の時刻に間に合わなかった tick の扱いを返します。
+		/// @return 予定の時刻に間に合わなかった tick の扱い
+		[[nodiscard]]
+		MissedTickBehavior getMissedTickBehavior() const noexcept;
+
+	private:
+		friend class detail::IntervalAwaiter;
+
+		Duration m_period;
+
+		TimePoint m_next{};
+
+		bool m_started;
+
+		MissedTickBehavior m_behavior;
+
+		// 現在時刻が now のときの tick の予定の時刻を返し、次の tick の予定の時刻に進める
+		TimePoint advance(const TimePoint& now) noexcept;
+	};
+}
+
+# include "detail/Interval.ipp"
@@ -0,0 +1,77 @@
+﻿# pragma once
+
+# if not defined(__linux__)
+#	error "CoroAsync/Io.hpp は Linux でのみ使用できます。"
+# endif
+
+# include <span>
+# include <vector>
+# include <system_error>
+# include <cerrno>
+# include <cstddef>
+# include <cstdint>
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+# include <sys/socket.h>
+# include <unistd.h>
+# include "Task.hpp"
+
+/// @brief CoroAsync
+namespace cra
+{
+	namespace detail
+	{
+		class IoReadinessAwaiter;
+		class IoReadAwaiter;
+		class IoWriteAwaiter;
+		class IoAcceptAwaiter;
+	}
+
+	/// @brief ファイルディスクリプタの I/O を待つ awaiter
+	/// @remark 待機中は、実行できるタスクがなければタスクキューが `epoll_wait` でブロックします。タイムアウトは次のスリープの終了時刻です。
+	/// @remark ファイルディスクリプタはノンブロッキングモードにしておいてください。
+	/// @remark タスクキューのタスクからのみ使用できます。1つのファイルディスクリプタに対して、読み込みと書き込みをそれぞれ1つのタスクまで同時に待てます。
+	/// 待っている間にファイルディスクリプタを閉じないでください。
+	namespace io
+	{
+		/// @brief ファイルディスクリプタが読み込み可能になるまで待つ awaiter を返します。
+		/// @param fd ファイルディスクリプタ
+		/// @return awaiter
+		[[nodiscard]]
+		detail::IoReadinessAwaiter Readable(int fd) noexcept;
+
+		/// @brief ファイルディスクリプタが書き込み可能になるまで待つ awaiter を返します。
+		/// @param fd ファイルディスクリプタ
+		/// @return awaiter
+		[[nodiscard]]
+		detail::IoReadinessAwaiter Writable(int fd) noexcept;
+
+		/// @brief ファイルディスクリプタから読み込む awaiter を返します。
+		/// @remark co_await 式の結果は読み込んだバイト数です。 0 の場合は終端に達しています。
+		/// @remark 読み込みに失敗した場合は、 co_await 式が `std::system_error` を投げます。
+		/// @param fd ファイルディスクリプタ
+		/// @param buffer 読み込み先
+		/// @return awaiter
+		[[nodiscard]]
+		detail::IoReadAwaiter Read(int fd, std::span<std::byte> buffer) noexcept;
+
+		/// @brief ファイルディスクリプタに書き込む awaiter を返します。
+		/// @remark co_await 式の結果は書き込んだバイト数です。 `buffer` のすべてが書き込まれるとは限りません。
+		/// @remark 書き込みに失敗した場合は、 co_await 式が `std::system_error` を投げます。
+		/// @param fd ファイルディスクリプタ
+		/// @param buffer 書き込むデータ
+		/// @return awaiter
+		[[nodiscard]]
+		detail::IoWriteAwaiter Write(int fd, std::span<const std::byte> buffer) noexcept;
+
+		/// @brief 待ち受けソケットへの接続を受け入れる awaiter を返します。
+		/// @remark co_await 式の結果は、ノンブロッキングモードで作成された接続のソケットです。
+		/// @remark 受け入れに失敗した場合は、 co_await 式が `std::system_error` を投げます。
+		/// @param fd 待ち受けソケット
+		/// @return awaiter
+		[[nodiscard]]
+		detail::IoAcceptAwaiter Accept(int fd) noexcept;
+	}
+}
+
+# include "detail/Io.ipp"
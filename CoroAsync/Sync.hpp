@@ -0,0 +1,261 @@
+﻿# pragma once
+
+# include <cstddef>
+# include <utility>
+# include "Task.hpp"
+
+/// @brief CoroAsync
+namespace cra
+{
+	namespace detail
+	{
+		class SyncWaiter;
+
+		// 同期プリミティブで待っているタスクの、侵入型の FIFO リスト
+		class SyncWaitList
+		{
+		public:
+			[[nodiscard]]
+			bool empty() const noexcept;
+
+			[[nodiscard]]
+			SyncWaiter* front() const noexcept;
+
+			void push_back(SyncWaiter& waiter) noexcept;
+
+			void erase(SyncWaiter& waiter) noexcept;
+
+			// 先頭の待機を解除し、そのタスクを実行待ちにする
+			void grantFront();
+
+			// すべての待機を解除し、それらのタスクを実行待ちにする
+			void grantAll();
+
+		private:
+			SyncWaiter* m_head = nullptr;
+			SyncWaiter* m_tail = nullptr;
+		};
+
+		class MutexLockAwaiter;
+		class MutexScopedLockAwaiter;
+		class SemaphoreAcquireAwaiter;
+		class ManualResetEventAwaiter;
+		class AsyncEventAwaiter;
+	}
+
+	class AsyncMutex;
+
+	/// @brief `AsyncMutex` のロックを所有し、破棄されるときにロックを解除するクラス
+	class AsyncMutexLock
+	{
+	public:
+		/// @brief ロックを所有しない AsyncMutexLock を作成します。
+		[[nodiscard]]
+		AsyncMutexLock() noexcept = default;
+
+		/// @brief ロック済みの mutex のロックを引き継ぎます。
+		/// @param mutex ロック済みの AsyncMutex
+		[[nodiscard]]
+		explicit AsyncMutexLock(AsyncMutex& mutex) noexcept;
+
+		/// @brief ムーブコンストラクタ
+		/// @param other ムーブ元
+		[[nodiscard]]
+		AsyncMutexLock(AsyncMutexLock&& other) noexcept;
+
+		/// @brief デストラクタ。ロックを所有していれば解除します。
+		~AsyncMutexLock();
+
+		/// @brief ムーブ代入演算子。ロックを所有していれば、先に解除します。
+		/// @param other ムーブ元
+		/// @return *this
+		AsyncMutexLock& operator =(AsyncMutexLock&& other) noexcept;
+
+		/// @brief ロックを所有しているかを返します。
+		/// @return ロックを所有していれば true
+		[[nodiscard]]
+		bool ownsLock() const noexcept;
+
+		/// @brief ロックを解除します。
+		void unlock();
+
+	private:
+		AsyncMutex* m_mutex = nullptr;
+	};
+
+	/// @brief co_await でロックを待てる mutex
+	/// @remark ロックを待っているタスクは、タスクキューに入らずに待機します。ロックが解除されると、先頭で待っているタスクがロックを引き継ぎ、タスクキューに追加されます。
+	/// @remark ロックを待っているタスクを破棄すると、待機の列からすぐに外されます。
+	/// @remark スレッドセーフではありません。同じスレッドのタスクキューのタスクからのみ使用してください。
+	class AsyncMutex
+	{
+	public:
+		/// @brief ロックされていない mutex を作成します。
+		[[nodiscard]]
+		AsyncMutex() noexcept = default;
+
+		/// @brief コピーコンストラクタ。コピー不可です。
+		AsyncMutex(const AsyncMutex&) = delete;
+
+		/// @brief コピー代入演算子。コピー不可です。
+		AsyncMutex& operator =(const AsyncMutex&) = delete;
+
+		/// @brief ロックを取得する awaiter を返します。
+		/// @remark co_await 式のオペランドに渡すと、ロックを取得できるまでタスクを中断します。
+		/// @return awaiter
+		[[nodiscard]]
+		detail::MutexLockAwaiter lock() noexcept;
+
+		/// @brief ロックを取得する awaiter を返します。
+		/// @remark co_await 式の結果は、ロックを所有する `AsyncMutexLock` です。
+		/// @return awaiter
+		[[nodiscard]]
+		detail::MutexScopedLockAwaiter scopedLock() noexcept;
+
+		/// @brief 待たずにロックの取得を試みます。
+		/// @return ロックを取得できた場合は true
+		[[nodiscard]]
+		bool try_lock() noexcept;
+
+		/// @brief ロックを解除します。
+		/// @remark ロックを待っているタスクがあれば、先頭のタスクにロックを引き継ぎます。
+		void unlock();
+
+		/// @brief ロックされているかを返します。
+		/// @return ロックされていれば true
+		[[nodiscard]]
+		bool isLocked() const noexcept;
+
+	private:
+		friend class detail::MutexLockAwaiter;
+
+		detail::SyncWaitList m_waiters;
+		bool m_locked = false;
+	};
+
+	/// @brief co_await で取得を待てるセマフォ
+	/// @remark 同時に実行する処理の数を制限するためなどに使います。
+	/// @remark 取得を待っているタスクは、タスクキューに入らずに待機します。解放されると、先頭で待っているタスクがそのまま取得し、タスクキューに追加されます。
+	/// @remark スレッドセーフではありません。同じスレッドのタスクキューのタスクからのみ使用してください。
+	class AsyncSemaphore
+	{
+	public:
+		/// @brief セマフォを作成します。
+		/// @param count カウンタの初期値
+		[[nodiscard]]
+		explicit AsyncSemaphore(std::ptrdiff_t count) noexcept;
+
+		/// @brief コピーコンストラクタ。コピー不可です。
+		AsyncSemaphore(const AsyncSemaphore&) = delete;
+
+		/// @brief コピー代入演算子。コピー不可です。
+		AsyncSemaphore& operator =(const AsyncSemaphore&) = delete;
+
+		/// @brief カウンタを1減らす awaiter を返します。
+		/// @remark co_await 式のオペランドに渡すと、カウンタが正になるまでタスクを中断します。
+		/// @return awaiter
+		[[nodiscard]]
+		detail::SemaphoreAcquireAwaiter acquire() noexcept;
+
+		/// @brief 待たずにカウンタを1減らすことを試みます。
+		/// @return カウンタを減らせた場合は true
+		[[nodiscard]]
+		bool try_acquire() noexcept;
+
+		/// @brief カウンタを増やします。
+		/// @remark 取得を待っているタスクがあれば、増やす代わりに先頭から順に引き渡します。
+		/// @param update 増やす量
+		void release(std::ptrdiff_t update = 1);
+
+		/// @brief カウンタの値を返します。
+		/// @return カウンタの値
+		[[nodiscard]]
+		std::ptrdiff_t available() const noexcept;
+
+	private:
+		friend class detail::SemaphoreAcquireAwaiter;
+
+		detail::SyncWaitList m_waiters;
+		std::ptrdiff_t m_count;
+	};
+
+	/// @brief シグナル状態を co_await で待てる、手動でリセットするイベント
+	/// @remark シグナル状態にすると、待っているすべてのタスクがタスクキューに追加されます。 `reset` を呼ぶまでシグナル状態のままです。
+	/// @remark スレッドセーフではありません。同じスレッドのタスクキューのタスクからのみ使用してください。
+	class ManualResetEvent
+	{
+	public:
+		/// @brief イベントを作成します。
+		/// @param initiallySet 初めからシグナル状態にする場合は true
+		[[nodiscard]]
+		explicit ManualResetEvent(bool initiallySet = false) noexcept;
+
+		/// @brief コピーコンストラクタ。コピー不可です。
+		ManualResetEvent(const ManualResetEvent&) = delete;
+
+		/// @brief コピー代入演算子。コピー不可です。
+		ManualResetEvent& operator =(const ManualResetEvent&) = delete;
+
+		/// @brief シグナル状態になるまで待つ awaiter を返します。
+		/// @return awaiter
+		[[nodiscard]]
+		detail::ManualResetEventAwaiter wait() noexcept;
+
+		/// @brief シグナル状態にし、待っているすべてのタスクを再開させます。
+		void set();
+
+		/// @brief 非シグナル状態にします。
+		void reset() noexcept;
+
+		/// @brief シグナル状態かを返します。
+		/// @return シグナル状態であれば true
+		[[nodiscard]]
+		bool isSet() const noexcept;
+
+	private:
+		detail::SyncWaitList m_waiters;
+		bool m_set;
+	};
+
+	/// @brief シグナル状態を co_await で待てる、自動でリセットするイベント
+	/// @remark シグナル状態にすると、待っているタスクのうち先頭の1つだけが再開し、イベントは非シグナル状態に戻ります。待っているタスクがなければ、次に待つタスクが来るまでシグナル状態のままです。
+	/// @remark スレッドセーフではありません。同じスレッドのタスクキューのタスクからのみ使用してください。
+	class AsyncEvent
+	{
+	public:
+		/// @brief イベントを作成します。
+		/// @param initiallySet 初めからシグナル状態にする場合は true
+		[[nodiscard]]
+		explicit AsyncEvent(bool initiallySet = false) noexcept;
+
+		/// @brief コピーコンストラクタ。コピー不可です。
+		AsyncEvent(const AsyncEvent&) = delete;
+
+		/// @brief コピー代入演算子。コピー不可です。
+		AsyncEvent& operator =(const AsyncEvent&) = delete;
+
+		/// @brief シグナル状態になるまで待つ awaiter を返します。
+		/// @return awaiter
+		[[nodiscard]]
+		detail::AsyncEventAwaiter wait() noexcept;
+
+		/// @brief シグナル状態にし、待っているタスクがあれば先頭の1つを再開させます。
+		void set();
+
+		/// @brief 非シグナル状態にします。
+		void reset() noexcept;
+
+		/// @brief シグナル状態かを返します。
+		/// @return シグナル状態であれば true
+		[[nodiscard]]
+		bool isSet() const noexcept;
+
+	private:
+		friend class detail::AsyncEventAwaiter;
+
+		detail::SyncWaitList m_waiters;
+		bool m_set;
+	};
+}
+
+# include "detail/Sync.ipp"
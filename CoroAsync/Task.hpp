@@ -2,16 +2,39 @@
 
 # include <coroutine>
 # include <future>
+# include <variant>
+# include <exception>
+# include <functional>
+# include <memory>
+# include <new>
 # include <chrono>
 # include <utility>
+# include <concepts>
+# include <type_traits>
 # include <cstdint>
 # include "TaskQueue.hpp"
+# include "Cancellation.hpp"
 
 /// @brief CoroAsync
 namespace cra
 {
+	namespace detail
+	{
+		class PromiseBase;
+		class SetPriorityAwaiter;
+		class SetCancellationTokenAwaiter;
+		class SetNameAwaiter;
+		class NextFrameAwaiter;
+	}
+
+	template <class Type>
+	class EagerTask;
+
 	/// @brief シングルスレッドで非同期処理をするためのクラス
 	/// @remark コルーチンの戻り値に指定して使用します。
+	/// @remark キャンセルされたタスクでは、 co_await 式が `OperationCanceled` を投げます。
+	/// @remark コルーチンフレームはタスクキューのフレームプールから確保されます。
+	/// コルーチンの引数の先頭（メンバ関数ではオブジェクトの次）に `std::allocator_arg` とアロケータを渡すと、そのアロケータで確保されます。
 	/// @tparam Type 非同期処理するコルーチンの戻り値の型
 	template <class Type = void>
 	class [[nodiscard]] Task
@@ -52,6 +75,8 @@ namespace cra
 
 		/// @brief タスクの完了を待機し、非同期処理の結果を返します。
 		/// @remark `get()` と `await_resume()` は1オブジェクトにつき合わせて1回しか呼び出せません。
+		/// @remark タスクが空の場合や、結果を取得済みの場合は `std::future_error` ( `std::future_errc::no_state` ) を投げます。
+		/// @remark タスクが例外で終了した場合、その例外を再送出します。
 		/// @return 非同期処理の結果
 		[[nodiscard]]
 		Type get();
@@ -75,6 +100,27 @@ namespace cra
 		/// @brief コルーチンを破棄します。
 		void destroy() noexcept;
 
+		/// @brief タスクの優先度を変更します。
+		/// @remark 実行待ちのタスクは、新しい優先度の実行待ちキューの末尾に移されます。
+		/// @param priority 優先度
+		void setPriority(TaskPriority priority) noexcept;
+
+		/// @brief タスクにキャンセル要求を受け取るトークンを結びつけます。
+		/// @remark 以前に結びつけられていたトークンとの結びつきは解除されます。トークンがすでにキャンセルされていれば、タスクもキャンセルされます。
+		/// @param token トークン。キャンセルされることのないトークンの場合は、結びつきを解除します。
+		void setCancellationToken(const CancellationToken& token);
+
+		/// @brief トレースで表示するタスクの名前を設定します。
+		/// @remark `CRA_ENABLE_TRACING` を定義してビルドしていない場合は、何もしません。
+		/// @param name タスクの名前。文字列リテラルなど、トレースを書き出すまで有効な文字列を指定してください。
+		void setName(const char* name) noexcept;
+
+		/// @brief タスクのトレース情報を返します。
+		/// @remark `CRA_ENABLE_TRACING` を定義してビルドしていない場合は、すべて 0 です。
+		/// @return トレース情報
+		[[nodiscard]]
+		TaskTraceInfo getTraceInfo() const noexcept;
+
 		/// @brief false を返します。
 		/// @remark co_await 式のオペランドに渡したときに呼び出されます。
 		/// @return true
@@ -92,14 +138,67 @@ namespace cra
 		class promise_type;
 
 	private:
-		using Handle = std::coroutine_handle<promise_type>;
+		friend class detail::PromiseBase;
+		template <class U>
+		friend class EagerTask;
+		template <class U>
+		friend void Spawn(Task<U> task) noexcept;
 
-		Handle m_coro;
-		std::future<Type> m_result;
+		promise_type* m_promise;
 
 		[[nodiscard]]
-		Task(Handle h, std::future<Type> f) noexcept;
+		explicit Task(promise_type* promise) noexcept;
 	};
+
+	/// @brief 実行中のタスクの優先度を変更する awaiter を返します。
+	/// @remark co_await 式のオペランドに渡すと、タスクを中断せずに優先度を変更します。以降に作成したタスクも、この優先度を引き継ぎます。
+	/// @param priority 優先度
+	/// @return awaiter
+	[[nodiscard]]
+	detail::SetPriorityAwaiter SetPriority(TaskPriority priority) noexcept;
+
+	/// @brief 実行中のタスクにキャンセル要求を受け取るトークンを結びつける awaiter を返します。
+	/// @remark co_await 式のオペランドに渡すと、タスクを中断せずにトークンを結びつけます。以降に作成したタスクにも、このトークンが結びつけられます。
+	/// @remark トークンがすでにキャンセルされていれば、次の co_await 式から `OperationCanceled` が投げられます。
+	/// @param token トークン。キャンセルされることのないトークンの場合は、結びつきを解除します。
+	/// @return awaiter
+	[[nodiscard]]
+	detail::SetCancellationTokenAwaiter SetCancellationToken(CancellationToken token) noexcept;
+
+	/// @brief トレースで表示する、実行中のタスクの名前を設定する awaiter を返します。
+	/// @remark co_await 式のオペランドに渡すと、タスクを中断せずに名前を設定します。
+	/// @remark `CRA_ENABLE_TRACING` を定義してビルドしていない場合は、何もしません。
+	/// @param name タスクの名前。文字列リテラルなど、トレースを書き出すまで有効な文字列を指定してください。
+	/// @return awaiter
+	[[nodiscard]]
+	detail::SetNameAwaiter SetName(const char* name) noexcept;
+
+	/// @brief 次のフレームの指定した段階まで、実行中のタスクを待機させる awaiter を返します。
+	/// @remark co_await 式のオペランドに渡すと、タスクキューの `TaskQueue::advanceFrame` で `phase` の段階のタスクが再開されるまで待機します。
+	/// `co_await 0` と異なり、フレームごとにちょうど1回再開されます。
+	/// @remark スレッドプールなど、タスクキュー以外のスケジューラで実行されるタスクでは、 `co_await 0` と同じです。
+	/// @param phase 再開する段階
+	/// @return awaiter
+	[[nodiscard]]
+	detail::NextFrameAwaiter NextFrame(FramePhase phase = FramePhase::Update) noexcept;
+
+	/// @brief 指定したフレーム数が経過するまで、実行中のタスクを待機させる awaiter を返します。
+	/// @remark co_await 式のオペランドに渡すと、 `phase` の段階のタスクの再開が `count` 回行われたときに再開します。 `Frames(1, phase)` は `NextFrame(phase)` と同じです。
+	/// @remark 待っている間も、フレームごとに段階の待機リストをたどる対象になります。長い時間を待つ場合は、スリープを使ってください。
+	/// @param count フレーム数。 0 の場合は中断しません。
+	/// @param phase 再開する段階
+	/// @return awaiter
+	[[nodiscard]]
+	detail::NextFrameAwaiter Frames(std::uint32_t count, FramePhase phase = FramePhase::Update) noexcept;
+
+	/// @brief タスクを切り離し、完了したときにコルーチンフレームを破棄させます。
+	/// @remark 結果を受け取らないタスクを、 `Task` を保持せずに最後まで実行させるために使います。すでに完了しているタスクは、すぐに破棄されます。
+	/// @remark タスクが例外で終了した場合、その例外は無視されます。
+	/// @remark 完了しないまま残ったタスクのコルーチンフレームは解放されません。
+	/// @tparam Type タスクの結果の型
+	/// @param task タスク
+	template <class Type>
+	void Spawn(Task<Type> task) noexcept;
 }
 
 # include "detail/Task.ipp"
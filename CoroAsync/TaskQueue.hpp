@@ -2,20 +2,130 @@
 
 # include <chrono>
 # include <coroutine>
-# include <deque>
-# include <set>
-# include <map>
+# include <vector>
 # include <thread>
+# include <atomic>
+# include <mutex>
+# include <condition_variable>
 # include <utility>
 # include <algorithm>
+# include <array>
+# include <new>
+# include <memory>
+# include <cstddef>
 # include <cstdint>
+# if defined(__linux__)
+#	include <time.h>
+# endif
+# include "Trace.hpp"
 
 /// @brief CoroAsync
 namespace cra
 {
-	/// @brief タスクキュー関連
-	namespace TaskQueue
+	/// @brief コルーチンフレームの確保に関する統計情報
+	/// @remark フレームプールはスレッドごとにあり、統計情報もスレッドごとに集計されます。
+	struct FrameStats
 	{
+		/// @brief このスレッドで確保されたコルーチンフレームの数から、このスレッドで解放された数を引いたもの
+		/// @remark 別のスレッドで確保されたフレームを解放した場合は、負になることもあります。
+		std::int64_t liveFrames = 0;
+
+		/// @brief これまでに確保されたコルーチンフレームの総数
+		std::uint64_t allocations = 0;
+
+		/// @brief フレームプールの空きブロックを再利用して確保できた回数
+		std::uint64_t poolHits = 0;
+
+		/// @brief フレームプールに収まらず、グローバルな `operator new` で確保した回数
+		std::uint64_t poolMisses = 0;
+
+		/// @brief 現在フレームプールに保持されている空きブロックの合計バイト数
+		std::size_t pooledBytes = 0;
+
+		/// @brief フレームプールのヒット率を返します。
+		/// @return フレームプールから確保した割合。確保が1度もなければ 0
+		[[nodiscard]]
+		double hitRate() const noexcept
+		{
+			const auto pooled = (poolHits + poolMisses);
+			return pooled ? static_cast<double>(poolHits) / static_cast<double>(pooled) : 0.0;
+		}
+	};
+
+	/// @brief タスクが別のタスクを co_await したときの継続の仕方
+	enum class ContinuationMode : std::uint8_t
+	{
+		/// @brief 待たれるタスクはタスクキューの順に実行され、その完了後に待っていたタスクがタスクキューの末尾に追加されます。
+		Queued,
+
+		/// @brief 待たれるタスクが未開始であればその場で開始し、その完了後に待っていたタスクをその場で再開します。
+		/// @remark 対称転送により切り替えるため、タスクキューを経由せず、スタックも消費しません。
+		Eager,
+	};
+
+	/// @brief タスクの優先度
+	/// @remark 優先度ごとに実行待ちキューがあり、優先度の高いタスクから実行されます。同じ優先度のタスクは、実行待ちになった順に実行されます。
+	/// @remark スレッドプールなど、タスクキュー以外のスケジューラで実行されるタスクでは無視されます。
+	enum class TaskPriority : std::uint8_t
+	{
+		/// @brief 入力の処理や描画など、遅延させたくないタスク
+		High,
+
+		/// @brief 通常のタスク。既定の優先度です。
+		Normal,
+
+		/// @brief 実行待ちのタスクがほかにないときに実行される、バックグラウンドのタスク
+		Low,
+	};
+
+	/// @brief タスクキューが現在時刻を得る方法
+	enum class ClockMode : std::uint8_t
+	{
+		/// @brief `std::chrono::steady_clock` を使います。既定の方法です。
+		Steady,
+
+		/// @brief 低精度で高速なクロックを使います。
+		/// @remark Linux では `CLOCK_MONOTONIC_COARSE` を使います。精度は数ミリ秒程度に下がり、期限やスリープの終了の判定もその分遅れます。ほかの環境では `Steady` と同じです。
+		Coarse,
+
+		/// @brief 実時間とは独立に進む、仮想の時刻を使います。
+		/// @remark 仮想の時刻は、タスクを実行している間は進みません。実行できるタスクがなくなると、実時間では待たずに、次にスリープが終了する時刻まで進みます。
+		/// @remark `co_await` でのスリープだけで時間が進むような処理を、実時間よりずっと速く、毎回同じ順序で実行できます。スリープの終了時刻が同じタスクは、スリープを始めた順に再開されます。
+		/// @remark I/O の準備完了や、 `RunOnPool` などで別のスレッドに任せた処理の完了だけを待つ場合は、実時間で待ちます。
+		Virtual,
+	};
+
+	/// @brief フレームの中の段階
+	/// @remark `co_await NextFrame(phase)` で待っているタスクは、 `TaskQueue::AdvanceFrame` でこの順に段階ごとに再開されます。
+	enum class FramePhase : std::uint8_t
+	{
+		/// @brief 入力やゲームロジックの更新。既定の段階です。
+		Update,
+
+		/// @brief すべての `Update` の後に行う、カメラの追従などの更新
+		LateUpdate,
+
+		/// @brief 描画
+		Render,
+	};
+
+	namespace detail
+	{
+		class TaskQueueImpl;
+
+		inline constexpr std::size_t TaskPriorityCount = 3;
+
+		inline constexpr std::size_t FramePhaseCount = 3;
+	}
+
+	/// @brief タスクキュー
+	/// @remark タスクは、作成されたスレッドの現在のタスクキューに追加されます。現在のタスクキューは `SetCurrent` で設定でき、 `runFor` や `runUntil` でタスクを実行している間はそのタスクキューになります。
+	/// @remark 設定されていなければ、スレッドごとに作成される既定のタスクキューが使われます。静的メンバ関数の `RunFor` と `RunUntil` は、現在のタスクキューのタスクを実行します。
+	/// @remark 異なるタスクキューのタスクも、同じスレッドで実行されるものであれば co_await できます。別のスレッドで実行されるタスクキューのタスクを co_await しないでください。
+	/// @remark タスクは優先度の高いものから実行されます。タイムクォンタムを設定すると、1回の再開でそれを続けて超過したタスクの優先度は下げられます。
+	class TaskQueue
+	{
+	public:
 		/// @brief タスクの管理に使用されるクロック型
 		using Clock = std::chrono::steady_clock;
 
@@ -25,16 +135,171 @@ namespace cra
 		/// @brief タスクの管理に使用されるハンドル型
 		using Handle = std::coroutine_handle<>;
 
-		/// @brief 相対時間で期限を指定して、タスクキューのタスクを実行します。
+		/// @brief 空のタスクキューを作成します。
+		[[nodiscard]]
+		TaskQueue();
+
+		/// @brief コピーコンストラクタ。コピー不可です。
+		TaskQueue(const TaskQueue&) = delete;
+
+		/// @brief デストラクタ
+		/// @remark このタスクキューのタスクは、タスクキューより先に破棄してください。
+		~TaskQueue();
+
+		/// @brief コピー代入演算子。コピー不可です。
+		TaskQueue& operator =(const TaskQueue&) = delete;
+
+		/// @brief 相対時間で期限を指定して、このタスクキューのタスクを実行します。
+		/// @remark 期限はタスクを1つ再開するたびに確認されます。
+		/// @remark 期限は `now` を基準にします。
 		/// @param relTime 相対時間の期限
+		/// @return 期限までの残り時間。期限を過ぎていれば 0
 		template <class Rep, class Period>
-		void RunFor(const std::chrono::duration<Rep, Period>& relTime);
+		Clock::duration runFor(const std::chrono::duration<Rep, Period>& relTime);
 
-		/// @brief 絶対時間で期限を指定して、タスクキューのタスクを実行します。
+		/// @brief 絶対時間で期限を指定して、このタスクキューのタスクを実行します。
+		/// @remark 実行できるタスクがなくても、 `RunOnPool` などで別のスレッドに任せた処理が残っている場合は、その完了か期限まで待ちます。
+		/// @remark 仮想の時刻を使う場合は、期限も仮想の時刻として扱い、待つものがなくなれば時刻を期限まで進めます。
 		/// @param absTime 絶対時間の期限
-		template <class Clock, class Duration>
-		void RunUntil(const std::chrono::time_point<Clock, Duration>& absTime);
-	}
+		template <class ClockType, class Duration>
+		void runUntil(const std::chrono::time_point<ClockType, Duration>& absTime);
+
+		/// @brief タイムクォンタムを設定します。
+		/// @remark 1回の再開でタイムクォンタムを超えて実行することが3回続いたタスクは、優先度が1つ下げられます。
+		/// @remark 既定では 0 で、優先度は下げられません。
+		/// @param quantum タイムクォンタム。 0 の場合は無制限
+		void setTimeQuantum(Clock::duration quantum) noexcept;
+
+		/// @brief タイムクォンタムを返します。
+		/// @return タイムクォンタム
+		[[nodiscard]]
+		Clock::duration getTimeQuantum() const noexcept;
+
+		/// @brief タイマースラックを設定します。
+		/// @remark 0 より大きくすると、このタスクキューのタスクのスリープの終了時刻が、タイマースラックの倍数の時刻に切り上げられます。
+		/// 終了時刻の近いタスクが同じ時刻にまとめて実行待ちになるため、多数のタスクが周期的にスリープする場合に、スレッドが起きる回数とタイマーの管理の負荷を減らせます。
+		/// @remark スリープは最大でタイマースラックだけ長くなります。 `Interval` の周期の基準になる時刻は切り上げられないため、周期はずれません。
+		/// @remark 既定では 0 で、終了時刻は切り上げられません。
+		/// @param slack タイマースラック
+		void setTimerSlack(Clock::duration slack) noexcept;
+
+		/// @brief タイマースラックを返します。
+		/// @return タイマースラック
+		[[nodiscard]]
+		Clock::duration getTimerSlack() const noexcept;
+
+		/// @brief 時刻を確認するまでに実行するタスクの最大数を設定します。
+		/// @remark 2 以上にすると、その時点で実行待ちのタスクを最大でこの数だけまとめて実行し、その間は期限、スリープの終了、別のスレッドからの完了通知を確認しません。
+		/// `co_await 0` で譲り合うだけのような短いタスクが多い場合に、時刻の取得の負荷を減らせます。
+		/// @remark まとめて実行している間は、タイムクォンタムによって優先度が下げられることはありません。
+		/// @remark 既定では 1 で、タスクを1つ実行するたびに時刻を確認します。
+		/// @param interval タスクの最大数。 0 の場合は 1
+		void setClockCheckInterval(std::uint32_t interval) noexcept;
+
+		/// @brief 時刻を確認するまでに実行するタスクの最大数を返します。
+		/// @return タスクの最大数
+		[[nodiscard]]
+		std::uint32_t getClockCheckInterval() const noexcept;
+
+		/// @brief 現在時刻を得る方法を設定します。
+		/// @remark `ClockMode::Virtual` に切り替えると、仮想の時刻はその時点の時刻から始まります。ほかの方法に戻すと、スリープの終了時刻は仮想の時刻のまま扱われるため、スリープ中のタスクがないときに切り替えてください。
+		/// @remark 既定では `ClockMode::Steady` です。
+		/// @param mode 現在時刻を得る方法
+		void setClockMode(ClockMode mode) noexcept;
+
+		/// @brief 現在時刻を得る方法を返します。
+		/// @return 現在時刻を得る方法
+		[[nodiscard]]
+		ClockMode getClockMode() const noexcept;
+
+		/// @brief このタスクキューのタスクが別のタスクを co_await したときの継続の仕方を設定します。
+		/// @remark `ContinuationMode::Eager` で待たれるタスクをその場で開始したり、待っていたタスクをその場で再開したりするのは、どちらも同じタスクキューのタスクの場合だけです。
+		/// @remark 既定では `ContinuationMode::Queued` です。
+		/// @param mode 継続の仕方
+		void setContinuationMode(ContinuationMode mode) noexcept;
+
+		/// @brief このタスクキューのタスクが別のタスクを co_await したときの継続の仕方を返します。
+		/// @return 継続の仕方
+		[[nodiscard]]
+		ContinuationMode getContinuationMode() const noexcept;
+
+		/// @brief このタスクキューの現在時刻を返します。
+		/// @remark スリープの終了時刻や、 `runFor` の期限の基準になる時刻です。仮想の時刻を使う場合は、仮想の時刻を返します。
+		/// @return 現在時刻
+		[[nodiscard]]
+		TimePoint now() const noexcept;
+
+		/// @brief フレームを1つ進め、フレームの区切りを待っているこのタスクキューのタスクを再開します。
+		/// @remark `co_await NextFrame(phase)` や `co_await Frames(count, phase)` で待っているタスクのうち、再開するものを `FramePhase` の順に、段階ごとに待ち始めた順で1回ずつ再開します。
+		/// 再開したタスクが同じ段階を再び待った場合は、次のフレームで再開されます。後の段階を待った場合は、このフレームのその段階で再開されます。
+		/// @remark 待っているタスクは段階ごとの配列に並べられ、実行待ちキューを経由せずに、配列を先頭から1回たどって再開されます。
+		/// @remark 再開したタスクが完了して実行待ちになったタスクなどは、 `runFor` などで実行されます。
+		/// @remark このタスクキューのタスクの再開中に呼ばないでください。
+		void advanceFrame();
+
+		/// @brief `advanceFrame` を呼んだ回数を返します。
+		/// @return フレーム数
+		[[nodiscard]]
+		std::uint64_t getFrameCount() const noexcept;
+
+		/// @brief このタスクキューのスケジューリングに関する統計情報を返します。
+		/// @remark 実行待ちのタスクの数とスリープ中のタスクの数以外は、 `CRA_ENABLE_TRACING` を定義してビルドした場合にのみ集計されます。
+		/// @remark フレームごとなど、定期的に取得して監視するためなどに使います。
+		/// @return 統計情報
+		[[nodiscard]]
+		TaskQueueStats getStats() const noexcept;
+
+		/// @brief このタスクキューのスケジューリングに関する統計情報の集計をやり直します。
+		void resetStats() noexcept;
+
+		/// @brief 現在のスレッドの現在のタスクキューを返します。
+		/// @return 現在のタスクキュー
+		[[nodiscard]]
+		static TaskQueue& Current();
+
+		/// @brief 現在のスレッドの現在のタスクキューを設定します。
+		/// @param queue タスクキュー。 nullptr の場合は既定のタスクキュー
+		static void SetCurrent(TaskQueue* queue) noexcept;
+
+		/// @brief 相対時間で期限を指定して、現在のタスクキューのタスクを実行します。
+		/// @param relTime 相対時間の期限
+		/// @return 期限までの残り時間。期限を過ぎていれば 0
+		template <class Rep, class Period>
+		static Clock::duration RunFor(const std::chrono::duration<Rep, Period>& relTime);
+
+		/// @brief 絶対時間で期限を指定して、現在のタスクキューのタスクを実行します。
+		/// @param absTime 絶対時間の期限
+		template <class ClockType, class Duration>
+		static void RunUntil(const std::chrono::time_point<ClockType, Duration>& absTime);
+
+		/// @brief 現在のタスクキューのフレームを1つ進めます。
+		/// @remark Siv3D の `System::Update()` のループなど、フレームごとに1回呼び出します。
+		static void AdvanceFrame();
+
+		/// @brief 現在のタスクキューのタスクが別のタスクを co_await したときの継続の仕方を設定します。
+		/// @remark 設定はタスクキューごとで、ほかのスレッドのタスクキューには影響しません。
+		/// @param mode 継続の仕方
+		static void SetContinuationMode(ContinuationMode mode);
+
+		/// @brief 現在のタスクキューのタスクが別のタスクを co_await したときの継続の仕方を返します。
+		/// @return 継続の仕方
+		[[nodiscard]]
+		static ContinuationMode GetContinuationMode();
+
+		/// @brief 現在のスレッドのコルーチンフレームの確保に関する統計情報を返します。
+		/// @return 統計情報
+		[[nodiscard]]
+		static FrameStats GetFrameStats() noexcept;
+
+		/// @brief 現在のスレッドのフレームプールに保持されている空きブロックをすべて解放します。
+		/// @remark 確保中のコルーチンフレームには影響しません。
+		static void ReleaseFrameMemory() noexcept;
+
+	private:
+		friend class detail::TaskQueueImpl;
+
+		std::unique_ptr<detail::TaskQueueImpl> m_impl;
+	};
 }
 
 # include "detail/TaskQueue.ipp"
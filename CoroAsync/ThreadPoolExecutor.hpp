@@ -0,0 +1,84 @@
+﻿# pragma once
+
+# include <thread>
+# include <mutex>
+# include <condition_variable>
+# include <atomic>
+# include <deque>
+# include <vector>
+# include <memory>
+# include <algorithm>
+# include <cstddef>
+# include <cstdint>
+# include "Task.hpp"
+
+/// @brief CoroAsync
+namespace cra
+{
+	namespace detail
+	{
+		class ThreadPoolExecutorImpl;
+		class ScheduleAwaiter;
+		template <class Function>
+		class RunOnPoolAwaiter;
+	}
+
+	class ThreadPoolExecutor;
+
+	/// @brief 関数をスレッドプールで呼び出し、完了後に呼び出し元のタスクをタスクキューで再開する awaiter を返します。
+	/// @remark co_await 式のオペランドに渡すと、タスクは中断され、関数の戻り値が co_await 式の結果になります。関数が例外を投げた場合は、 co_await 式がその例外を投げます。
+	/// @remark 圧縮やハッシュ計算など、タスクキューを止めてしまう同期的な処理を別のスレッドで行うために使います。
+	/// @remark 関数の完了を待つ間にタスクが破棄されても、関数の呼び出しは最後まで行われます。
+	/// @param pool 関数を呼び出すスレッドプール
+	/// @param function 引数なしで呼び出せる関数
+	/// @return awaiter
+	template <class Function>
+	[[nodiscard]]
+	detail::RunOnPoolAwaiter<std::decay_t<Function>> RunOnPool(ThreadPoolExecutor& pool, Function&& function);
+
+	/// @brief タスクを複数のスレッドで並列に実行するスケジューラ
+	/// @remark `co_await executor.schedule()` でタスクをスレッドプールに移すと、それ以降そのタスクと、そのタスクが作成したタスクはワーカースレッドで実行されます。
+	/// @remark ワーカースレッドごとに work-stealing deque を持ち、手の空いたワーカーは他のワーカーのタスクを盗んで実行します。
+	/// @remark スレッドプールで実行されるタスクどうしの待機はスレッドセーフですが、タスクキューのタスクとスレッドプールのタスクを1つの `WhenAll` や `WhenAny` に混ぜることはできません。
+	/// @remark タスクキューのタスクがスレッドプールのタスクを co_await した場合は、待ち始めた後でスレッドプールに移ったタスクも含め、完了後に元のタスクキューのスレッドで再開されます。
+	/// また、スレッドプールに移る前に作成したタスクを、移った後で co_await しないでください。
+	class ThreadPoolExecutor
+	{
+	public:
+		/// @brief ワーカースレッドを起動します。
+		/// @param threadCount ワーカースレッドの数
+		[[nodiscard]]
+		explicit ThreadPoolExecutor(std::size_t threadCount = std::max<std::size_t>(std::thread::hardware_concurrency(), 1));
+
+		/// @brief コピーコンストラクタ。コピー不可です。
+		ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+
+		/// @brief デストラクタ。ワーカースレッドを停止します。
+		/// @remark 未完了のタスクは、実行待ちであっても、それ以上実行されません。その `Task` はスレッドプールより後に破棄しても構いませんが、完了することはありません。
+		/// @remark `RunOnPool` で渡された関数のうち、まだ呼び出されていないものは、このスレッドで呼び出されます。
+		/// @remark タスクキューのタスクがスレッドプールのタスクの完了を待っている場合は、そのタスクキューのスレッドで破棄してください。
+		~ThreadPoolExecutor();
+
+		/// @brief コピー代入演算子。コピー不可です。
+		ThreadPoolExecutor& operator =(const ThreadPoolExecutor&) = delete;
+
+		/// @brief ワーカースレッドの数を返します。
+		/// @return ワーカースレッドの数
+		[[nodiscard]]
+		std::size_t threadCount() const noexcept;
+
+		/// @brief 現在のタスクをスレッドプールに移す awaiter を返します。
+		/// @remark co_await 式のオペランドに渡すと、タスクは中断され、いずれかのワーカースレッドで再開されます。
+		/// @return awaiter
+		[[nodiscard]]
+		detail::ScheduleAwaiter schedule() noexcept;
+
+	private:
+		template <class Function>
+		friend detail::RunOnPoolAwaiter<std::decay_t<Function>> RunOnPool(ThreadPoolExecutor& pool, Function&& function);
+
+		std::unique_ptr<detail::ThreadPoolExecutorImpl> m_impl;
+	};
+}
+
+# include "detail/ThreadPoolExecutor.ipp"
@@ -0,0 +1,154 @@
+﻿# pragma once
+
+# include <chrono>
+# include <atomic>
+# include <vector>
+# include <memory>
+# include <ostream>
+# include <string_view>
+# include <algorithm>
+# include <bit>
+# include <cstddef>
+# include <cstdint>
+
+/// @brief CoroAsync
+namespace cra
+{
+	/// @brief トレースのイベントの種類
+	enum class TraceEventType : std::uint8_t
+	{
+		/// @brief タスクが実行待ちキューに追加された
+		Push,
+
+		/// @brief タスクが1回再開されて、中断するまで実行された
+		Run,
+
+		/// @brief タスクがスリープを始めた
+		Sleep,
+
+		/// @brief スリープの終了時刻になり、タスクが実行待ちになった
+		Wake,
+
+		/// @brief タスクが別のタスクの完了を待ち始めた
+		Wait,
+
+		/// @brief タスクが完了した
+		Complete,
+	};
+
+	/// @brief トレースのイベント
+	struct TraceEvent
+	{
+		/// @brief 発生した時刻。 `TraceEventType::Run` の場合は実行を始めた時刻
+		std::chrono::steady_clock::time_point time{};
+
+		/// @brief `TraceEventType::Run` の場合は実行時間、 `TraceEventType::Sleep` の場合はスリープの長さ、 `TraceEventType::Wake` の場合は終了時刻からの遅れ
+		std::chrono::steady_clock::duration duration{};
+
+		/// @brief タスクの ID
+		std::uint64_t taskId = 0;
+
+		/// @brief タスクの名前。設定されていなければ nullptr
+		const char* taskName = nullptr;
+
+		/// @brief イベントが発生したスレッドの番号
+		std::uint32_t threadId = 0;
+
+		/// @brief `TraceEventType::Push` の場合は、追加した後の実行待ちのタスクの数
+		std::uint32_t queueDepth = 0;
+
+		/// @brief イベントの種類
+		TraceEventType type = TraceEventType::Push;
+	};
+
+	/// @brief タスクキューのスケジューリングに関する統計情報
+	/// @remark `readyTasks` と `sleepingTasks` 以外は、 `CRA_ENABLE_TRACING` を定義してビルドした場合にのみ集計されます。
+	struct TaskQueueStats
+	{
+		/// @brief 実行待ちキューに追加された回数
+		std::uint64_t pushes = 0;
+
+		/// @brief タスクが再開された回数
+		std::uint64_t resumes = 0;
+
+		/// @brief タスクがスリープを始めた回数
+		std::uint64_t sleeps = 0;
+
+		/// @brief タスクが別のタスクの完了を待ち始めた回数
+		std::uint64_t waits = 0;
+
+		/// @brief 完了したタスクの数
+		std::uint64_t completions = 0;
+
+		/// @brief 現在の実行待ちのタスクの数
+		std::size_t readyTasks = 0;
+
+		/// @brief 実行待ちのタスクの数の最大値
+		std::size_t maxReadyTasks = 0;
+
+		/// @brief 現在のスリープ中のタスクの数
+		std::size_t sleepingTasks = 0;
+
+		/// @brief タスクを実行していた時間の合計
+		std::chrono::steady_clock::duration runTime{};
+
+		/// @brief スリープの終了時刻から、実際に実行待ちになるまでの遅れの合計
+		std::chrono::steady_clock::duration timerSlip{};
+
+		/// @brief スリープの終了時刻から、実際に実行待ちになるまでの遅れの最大値
+		std::chrono::steady_clock::duration maxTimerSlip{};
+	};
+
+	/// @brief タスクごとのトレース情報
+	/// @remark `CRA_ENABLE_TRACING` を定義してビルドした場合にのみ集計されます。
+	struct TaskTraceInfo
+	{
+		/// @brief タスクの ID。トレースのイベントの `TraceEvent::taskId` と対応します。
+		std::uint64_t id = 0;
+
+		/// @brief タスクの名前。設定されていなければ nullptr
+		const char* name = nullptr;
+
+		/// @brief 再開された回数
+		std::uint64_t resumes = 0;
+
+		/// @brief 実行していた時間の合計
+		std::chrono::steady_clock::duration runTime{};
+
+		/// @brief スリープの終了時刻から、実際に実行待ちになるまでの遅れの合計
+		std::chrono::steady_clock::duration timerSlip{};
+	};
+
+	/// @brief タスクキューのスケジューリングのトレース
+	/// @remark `CRA_ENABLE_TRACING` を定義してビルドした場合にのみ記録されます。定義しなければ、記録のための処理はすべて取り除かれます。
+	/// @remark イベントはすべてのスレッドで共有されるリングバッファにロックなしで記録され、容量を超えると古いものから上書きされます。
+	/// @remark タスクキューで実行されるタスクのみが記録されます。スレッドプールなどで実行されるタスクは記録されません。
+	class Tracing
+	{
+	public:
+		/// @brief リングバッファの既定の容量
+		static constexpr std::size_t DefaultCapacity = (1 << 16);
+
+		/// @brief トレースが有効なビルドかを返します。
+		/// @return `CRA_ENABLE_TRACING` が定義されていれば true
+		[[nodiscard]]
+		static constexpr bool IsEnabled() noexcept;
+
+		/// @brief 記録されたイベントを消去し、リングバッファの容量を設定します。
+		/// @remark ほかのスレッドがイベントを記録していないときに呼んでください。
+		/// @param capacity リングバッファの容量。2 の累乗に切り上げられます。
+		static void Reset(std::size_t capacity = DefaultCapacity);
+
+		/// @brief 記録されているイベントを、古いものから順に返します。
+		/// @remark 記録中に呼ぶこともできます。その間に上書きされたイベントは含まれません。
+		/// @return イベントの配列
+		[[nodiscard]]
+		static std::vector<TraceEvent> Snapshot();
+
+		/// @brief 記録されているイベントを、 Chrome や Perfetto で読み込める JSON 形式で書き出します。
+		/// @param os 出力先のストリーム
+		static void WriteChromeTrace(std::ostream& os);
+	};
+}
+
+# include "detail/Trace.ipp"
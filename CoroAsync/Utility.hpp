@@ -3,6 +3,9 @@
 # include "Task.hpp"
 # include <tuple>
 # include <variant>
+# include <vector>
+# include <array>
+# include <ranges>
 # include <type_traits>
 # include <utility>
 # include <cstddef>
@@ -25,6 +28,13 @@ namespace cra
 		{
 			using type = decltype(std::tuple_cat(std::declval<std::tuple<T>>(), std::declval<WhenAllResult_t<Types...>>()));
 		};
+
+		template <class Type>
+		struct WhenAllRangeResult { using type = std::vector<Type>; };
+		template <>
+		struct WhenAllRangeResult<void> { using type = void; };
+		template <class Type>
+		using WhenAllRangeResult_t = typename WhenAllRangeResult<Type>::type;
 	}
 
 	/// @brief 指定したすべてのタスクが終了するのを待つタスクを作成します。
@@ -47,6 +57,31 @@ namespace cra
 	/// @return 指定したタスクの型を引数の順に設定した `std::variant` に、最初に完了したタスクを結果とするタスク
 	template <class... Types>
 	Task<std::variant<Task<Types>...>> WhenAny(Task<Types>... tasks);
+
+	/// @brief 指定したすべてのタスクが終了するのを待つタスクを作成します。
+	/// @tparam Type タスクの結果の型
+	/// @param tasks タスクの配列
+	/// @return 指定したタスクの結果を順に `std::vector` に詰めたものを結果とするタスク。 `Type` が `void` の場合は `Task<void>`
+	template <class Type>
+	Task<detail::WhenAllRangeResult_t<Type>> WhenAll(std::vector<Task<Type>> tasks);
+
+	/// @brief 指定した範囲のタスクのいずれかが終了するのを待つタスクを作成します。
+	/// @tparam Range `cra::Task` を要素とする範囲の型
+	/// @param tasks タスクの範囲
+	/// @return 最初に完了したタスクのインデックスを結果とするタスク。範囲が空の場合は 0
+	template <std::ranges::forward_range Range>
+		requires detail::IsTask<std::ranges::range_value_t<Range>>::value
+	Task<std::size_t> WhenAny(Range& tasks);
+
+	/// @brief 指定した時間内に終了しなければキャンセルされるように、タスクを包んだタスクを作成します。
+	/// @remark 時間内に終了しなかった場合、 `task` はキャンセルされ、作成したタスクの結果を取得すると `OperationCanceled` が投げられます。
+	/// @remark `task` がタスクキュー以外のスケジューラで実行される場合は、キャンセルされずに終了を待ちます。
+	/// @tparam Type タスクの結果の型
+	/// @param task タスク
+	/// @param timeout 制限時間
+	/// @return `task` の結果を結果とするタスク
+	template <class Type, class Rep, class Period>
+	Task<Type> WithTimeout(Task<Type> task, std::chrono::duration<Rep, Period> timeout);
 }
 
 # include "detail/Utility.ipp"
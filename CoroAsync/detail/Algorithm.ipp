@@ -0,0 +1,165 @@
+﻿# pragma once
+
+namespace cra
+{
+	namespace detail
+	{
+		// ForEachAsync などで、1回にまとめて処理する要素の数を決める
+		// まとめて処理するたびに経過時間を測り、処理を譲るまでの時間が budget に収まるように数を調整する
+		class SliceTimer
+		{
+		public:
+			using Clock = TaskQueue::Clock;
+
+			explicit SliceTimer(Clock::duration budget) noexcept
+				: m_budget{ std::max(budget, Clock::duration{ 1 }) } {}
+
+			// 次にまとめて処理する要素の数
+			[[nodiscard]]
+			std::size_t chunkSize() const noexcept
+			{
+				return m_chunkSize;
+			}
+
+			// processed 個の要素を処理した後に呼ぶ
+			// 処理を譲る必要があれば true を返す
+			[[nodiscard]]
+			bool finishChunk(std::size_t processed) noexcept
+			{
+				const auto now = Clock::now();
+				const auto elapsed = (now - m_chunkStart);
+				m_chunkStart = now;
+				const auto remaining = (m_budget - (now - m_sliceStart));
+				const bool yield = (remaining <= Clock::duration::zero());
+				// 残りの時間、譲った後は次の1回分の時間に収まる数にする。急に増やしすぎないように、増やすのは倍までにする
+				const auto target = yield ? m_budget : remaining;
+				const auto ticks = static_cast<double>(std::max(elapsed, Clock::duration{ 1 }).count());
+				const auto estimate = static_cast<double>(processed) * static_cast<double>(target.count()) / ticks;
+				m_chunkSize = static_cast<std::size_t>(std::clamp(estimate, 1.0, static_cast<double>(std::max<std::size_t>(processed, 1) * 2)));
+				return yield;
+			}
+
+			// 処理を譲った後、再開したときに呼ぶ
+			void startSlice() noexcept
+			{
+				m_sliceStart = m_chunkStart = Clock::now();
+			}
+
+		private:
+			Clock::duration m_budget;
+			Clock::time_point m_sliceStart = Clock::now();
+			Clock::time_point m_chunkStart = m_sliceStart;
+			std::size_t m_chunkSize = 1;
+		};
+
+		// スレッドプールで並列に処理するときの、ワーカースレッドあたりのブロックの数
+		inline constexpr std::size_t BlocksPerThread = 4;
+
+		// [begin, end) の範囲を block で処理するタスク
+		// block はタスクが破棄された後もスレッドプールで使われうるので、共有して持つ
+		// 初期化キャプチャのあるラムダ式を co_await 式の中に書くと GCC 12 で二重に破棄されるため、変数に入れてから渡す
+		template <class Block>
+		Task<> RunBlockOnPool(ThreadPoolExecutor& pool, std::shared_ptr<Block> block, std::size_t begin, std::size_t end)
+		{
+			auto job = [block = std::move(block), begin, end] { (*block)(begin, end); };
+			co_await RunOnPool(pool, std::move(job));
+		}
+
+		// [0, size) をブロックに分けて、スレッドプールで並列に block で処理するタスク
+		template <class Block>
+		Task<> RunBlocksOnPool(ThreadPoolExecutor& pool, std::size_t size, Block block)
+		{
+			const auto blockCount = std::min(size, (pool.threadCount() * BlocksPerThread));
+			if (blockCount == 0)
+			{
+				co_return;
+			}
+			auto shared = std::make_shared<Block>(std::move(block));
+			std::vector<Task<>> tasks;
+			tasks.reserve(blockCount);
+			for (std::size_t i = 0; i < blockCount; ++i)
+			{
+				tasks.push_back(RunBlockOnPool(pool, shared, (size * i / blockCount), (size * (i + 1) / blockCount)));
+			}
+			co_await WhenAll(std::move(tasks));
+		}
+	}
+
+	template <std::ranges::input_range Range, class Function>
+		requires std::invocable<Function&, std::ranges::range_reference_t<Range>>
+	Task<> ForEachAsync(Range& range, Function function, TaskQueue::Clock::duration budget)
+	{
+		detail::SliceTimer timer{ budget };
+		auto it = std::ranges::begin(range);
+		const auto last = std::ranges::end(range);
+		while (it != last)
+		{
+			std::size_t processed = 0;
+			for (const auto chunkSize = timer.chunkSize(); processed < chunkSize && it != last; ++processed, ++it)
+			{
+				std::invoke(function, *it);
+			}
+			if (timer.finishChunk(processed) && it != last)
+			{
+				co_await 0;
+				timer.startSlice();
+			}
+		}
+	}
+
+	template <std::ranges::input_range Range, std::weakly_incrementable Out, class Function>
+		requires std::indirectly_writable<Out, std::invoke_result_t<Function&, std::ranges::range_reference_t<Range>>>
+	Task<Out> TransformAsync(Range& range, Out out, Function function, TaskQueue::Clock::duration budget)
+	{
+		detail::SliceTimer timer{ budget };
+		auto it = std::ranges::begin(range);
+		const auto last = std::ranges::end(range);
+		while (it != last)
+		{
+			std::size_t processed = 0;
+			for (const auto chunkSize = timer.chunkSize(); processed < chunkSize && it != last; ++processed, ++it, ++out)
+			{
+				*out = std::invoke(function, *it);
+			}
+			if (timer.finishChunk(processed) && it != last)
+			{
+				co_await 0;
+				timer.startSlice();
+			}
+		}
+		co_return out;
+	}
+
+	template <std::ranges::random_access_range Range, class Function>
+		requires std::invocable<Function&, std::ranges::range_reference_t<Range>>
+	Task<> ForEachAsync(ThreadPoolExecutor& pool, Range& range, Function function)
+	{
+		const auto first = std::ranges::begin(range);
+		auto block = [first, function = std::move(function)](std::size_t begin, std::size_t end) mutable
+		{
+			for (auto it = first + begin; it != first + end; ++it)
+			{
+				std::invoke(function, *it);
+			}
+		};
+		co_await detail::RunBlocksOnPool(pool, static_cast<std::size_t>(std::ranges::distance(range)), std::move(block));
+	}
+
+	template <std::ranges::random_access_range Range, std::random_access_iterator Out, class Function>
+		requires std::indirectly_writable<Out, std::invoke_result_t<Function&, std::ranges::range_reference_t<Range>>>
+	Task<Out> TransformAsync(ThreadPoolExecutor& pool, Range& range, Out out, Function function)
+	{
+		const auto first = std::ranges::begin(range);
+		const auto size = static_cast<std::size_t>(std::ranges::distance(range));
+		auto block = [first, out, function = std::move(function)](std::size_t begin, std::size_t end) mutable
+		{
+			auto dest = out + begin;
+			for (auto it = first + begin; it != first + end; ++it, ++dest)
+			{
+				*dest = std::invoke(function, *it);
+			}
+		};
+		co_await detail::RunBlocksOnPool(pool, size, std::move(block));
+		co_return out + size;
+	}
+}
@@ -0,0 +1,95 @@
+﻿# pragma once
+
+namespace cra
+{
+	inline const char* OperationCanceled::what() const noexcept
+	{
+		return "cra::OperationCanceled";
+	}
+
+	inline CancellationToken::CancellationToken(detail::CancellationState* state) noexcept
+		: m_state{ state }
+	{
+		if (m_state)
+		{
+			m_state->addRef();
+		}
+	}
+
+	inline CancellationToken::CancellationToken(const CancellationToken& other) noexcept
+		: CancellationToken{ other.m_state } {}
+
+	inline CancellationToken::CancellationToken(CancellationToken&& other) noexcept
+		: m_state{ std::exchange(other.m_state, nullptr) } {}
+
+	inline CancellationToken::~CancellationToken()
+	{
+		if (m_state)
+		{
+			m_state->release();
+		}
+	}
+
+	inline CancellationToken& CancellationToken::operator =(const CancellationToken& other) noexcept
+	{
+		if (m_state != other.m_state)
+		{
+			if (other.m_state)
+			{
+				other.m_state->addRef();
+			}
+			if (m_state)
+			{
+				m_state->release();
+			}
+			m_state = other.m_state;
+		}
+		return *this;
+	}
+
+	inline CancellationToken& CancellationToken::operator =(CancellationToken&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (m_state)
+			{
+				m_state->release();
+			}
+			m_state = std::exchange(other.m_state, nullptr);
+		}
+		return *this;
+	}
+
+	inline bool CancellationToken::isCancellationRequested() const noexcept
+	{
+		return m_state && m_state->isCanceled();
+	}
+
+	inline bool CancellationToken::canBeCanceled() const noexcept
+	{
+		return m_state != nullptr;
+	}
+
+	inline CancellationSource::CancellationSource()
+		: m_state{ new detail::CancellationState{} } {}
+
+	inline CancellationSource::~CancellationSource()
+	{
+		m_state->release();
+	}
+
+	inline CancellationToken CancellationSource::token() const noexcept
+	{
+		return CancellationToken{ m_state };
+	}
+
+	inline void CancellationSource::cancel()
+	{
+		m_state->cancel();
+	}
+
+	inline bool CancellationSource::isCancellationRequested() const noexcept
+	{
+		return m_state->isCanceled();
+	}
+}
@@ -0,0 +1,283 @@
+﻿# pragma once
+
+namespace cra
+{
+	namespace detail
+	{
+		// Channel::send の awaiter
+		// 送信する値を持ち、待っている間は受信側がここから直接値を取り出す
+		template <class Type>
+		class ChannelSendAwaiter : public SyncWaiter
+		{
+		public:
+			ChannelSendAwaiter(Channel<Type>& channel, Type&& value)
+				: m_channel{ channel }, m_value{ std::move(value) } {}
+			bool await_ready()
+			{
+				if (m_channel.m_closed)
+				{
+					return true;
+				}
+				return (m_sent = m_channel.offer(m_value));
+			}
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				suspendOn(m_channel.m_senders, h);
+			}
+			bool await_resume() const noexcept
+			{
+				return m_sent;
+			}
+			// 受信側が値を取り出した後は、キャンセルされても送信に成功したものとして再開する
+			bool isCompleted() const noexcept
+			{
+				return m_sent;
+			}
+
+		private:
+			friend class Channel<Type>;
+
+			Channel<Type>& m_channel;
+			Type m_value;
+			bool m_sent = false;
+		};
+
+		// 受信の awaiter の共通部分
+		// 待っている間は送信側がここへ直接値を渡す
+		// 値を渡された後、再開する前にタスクが破棄やキャンセルされた場合は、値をチャネルに戻す
+		template <class Type>
+		class ChannelReceiverBase : public SyncWaiter
+		{
+		public:
+			ChannelReceiverBase(ChannelReceiverBase&&) = default;
+			~ChannelReceiverBase()
+			{
+				if (isGrantPending() && m_value)
+				{
+					m_channel.giveBack(std::move(*m_value));
+				}
+			}
+
+		protected:
+			friend class Channel<Type>;
+
+			explicit ChannelReceiverBase(Channel<Type>& channel) noexcept
+				: m_channel{ channel } {}
+
+			template <class Promise>
+			void suspendOn(std::coroutine_handle<Promise> h) noexcept
+			{
+				SyncWaiter::suspendOn(m_channel.m_receivers, h);
+			}
+
+			Channel<Type>& m_channel;
+			std::optional<Type> m_value;
+		};
+
+		// Channel::receive の awaiter
+		template <class Type>
+		class ChannelReceiveAwaiter : public ChannelReceiverBase<Type>
+		{
+		public:
+			explicit ChannelReceiveAwaiter(Channel<Type>& channel) noexcept
+				: ChannelReceiverBase<Type>{ channel } {}
+			bool await_ready()
+			{
+				return this->m_channel.take([this](Type&& value) { this->m_value.emplace(std::move(value)); })
+					|| this->m_channel.m_closed;
+			}
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				this->suspendOn(h);
+			}
+			std::optional<Type> await_resume()
+			{
+				this->markResumed();
+				return std::move(this->m_value);
+			}
+		};
+
+		// Channel::receiveMany の awaiter
+		// 中断した場合は1つだけ値を受け取って再開し、再開時に残りをまとめて取り出す
+		template <class Type>
+		class ChannelReceiveManyAwaiter : public ChannelReceiverBase<Type>
+		{
+		public:
+			ChannelReceiveManyAwaiter(Channel<Type>& channel, std::span<Type> out) noexcept
+				: ChannelReceiverBase<Type>{ channel }, m_out{ out } {}
+			bool await_ready() const noexcept
+			{
+				const auto& channel = this->m_channel;
+				return m_out.empty() || channel.size() || (not channel.m_senders.empty()) || channel.m_closed;
+			}
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				this->suspendOn(h);
+			}
+			std::size_t await_resume()
+			{
+				this->markResumed();
+				std::size_t count = 0;
+				if (this->m_value)
+				{
+					m_out[count++] = std::move(*this->m_value);
+					this->m_value.reset();
+				}
+				while (count < m_out.size()
+					&& this->m_channel.take([&](Type&& value) { m_out[count] = std::move(value); }))
+				{
+					++count;
+				}
+				return count;
+			}
+
+		private:
+			std::span<Type> m_out;
+		};
+	}
+
+	template <class Type>
+	inline Channel<Type>::Channel(const std::size_t capacity)
+		: m_buffer{ capacity ? std::allocator<Type>{}.allocate(capacity) : nullptr }
+		, m_capacity{ capacity } {}
+
+	template <class Type>
+	inline Channel<Type>::~Channel()
+	{
+		for (; m_size; --m_size)
+		{
+			std::destroy_at(m_buffer + m_head);
+			m_head = ((m_head + 1) % m_capacity);
+		}
+		if (m_buffer)
+		{
+			std::allocator<Type>{}.deallocate(m_buffer, m_capacity);
+		}
+	}
+
+	template <class Type>
+	inline detail::ChannelSendAwaiter<Type> Channel<Type>::send(Type value)
+	{
+		return detail::ChannelSendAwaiter<Type>{ *this, std::move(value) };
+	}
+
+	template <class Type>
+	inline detail::ChannelReceiveAwaiter<Type> Channel<Type>::receive() noexcept
+	{
+		return detail::ChannelReceiveAwaiter<Type>{ *this };
+	}
+
+	template <class Type>
+	inline detail::ChannelReceiveManyAwaiter<Type> Channel<Type>::receiveMany(std::span<Type> out) noexcept
+	{
+		return detail::ChannelReceiveManyAwaiter<Type>{ *this, out };
+	}
+
+	template <class Type>
+	inline void Channel<Type>::close()
+	{
+		m_closed = true;
+		// 受信側は値を受け取らずに、送信側は送信に失敗して再開する
+		m_receivers.grantAll();
+		m_senders.grantAll();
+	}
+
+	template <class Type>
+	inline bool Channel<Type>::isClosed() const noexcept
+	{
+		return m_closed;
+	}
+
+	template <class Type>
+	inline std::size_t Channel<Type>::size() const noexcept
+	{
+		return (m_size + m_returned.size());
+	}
+
+	template <class Type>
+	inline std::size_t Channel<Type>::capacity() const noexcept
+	{
+		return m_capacity;
+	}
+
+	// 待っている受信側かバッファに value を渡す
+	// 受信側が待っているときは、バッファは空である
+	template <class Type>
+	inline bool Channel<Type>::offer(Type& value)
+	{
+		if (auto* waiter = m_receivers.front())
+		{
+			static_cast<detail::ChannelReceiverBase<Type>&>(*waiter).m_value.emplace(std::move(value));
+			m_receivers.grantFront();
+			return true;
+		}
+		if (m_size < m_capacity)
+		{
+			std::construct_at(m_buffer + ((m_head + m_size) % m_capacity), std::move(value));
+			++m_size;
+			return true;
+		}
+		return false;
+	}
+
+	// 受信側が再開せずに手放した value を、次に待っている受信側に渡すか、最初に取り出される値として保持する
+	// 受信側が待っているときは、保持している値はない
+	template <class Type>
+	inline void Channel<Type>::giveBack(Type&& value)
+	{
+		if (auto* waiter = m_receivers.front())
+		{
+			static_cast<detail::ChannelReceiverBase<Type>&>(*waiter).m_value.emplace(std::move(value));
+			m_receivers.grantFront();
+			return;
+		}
+		m_returned.push_back(std::move(value));
+	}
+
+	// 戻された値、バッファ、待っている送信側の順に値を1つ取り出して sink に渡す
+	// 送信側が待っているときは、バッファは満杯である
+	template <class Type>
+	template <class Sink>
+	inline bool Channel<Type>::take(Sink&& sink)
+	{
+		// 戻された値は、バッファの値より先に送信されている
+		if (not m_returned.empty())
+		{
+			sink(std::move(m_returned.front()));
+			m_returned.pop_front();
+			return true;
+		}
+		auto* waiter = static_cast<detail::ChannelSendAwaiter<Type>*>(m_senders.front());
+		if (m_size)
+		{
+			Type& front = m_buffer[m_head];
+			sink(std::move(front));
+			std::destroy_at(&front);
+			m_head = ((m_head + 1) % m_capacity);
+			--m_size;
+			if (waiter)
+			{
+				// 空いた場所に、待っている送信側の値を詰める
+				std::construct_at(m_buffer + ((m_head + m_size) % m_capacity), std::move(waiter->m_value));
+				++m_size;
+			}
+		}
+		else if (waiter)
+		{
+			sink(std::move(waiter->m_value));
+		}
+		else
+		{
+			return false;
+		}
+		if (waiter)
+		{
+			waiter->m_sent = true;
+			m_senders.grantFront();
+		}
+		return true;
+	}
+}
@@ -0,0 +1,31 @@
+﻿# pragma once
+
+namespace cra
+{
+	namespace detail
+	{
+		template <class Type>
+		struct IsTask<EagerTask<Type>> : std::true_type {};
+	}
+
+	template <class Type>
+	inline EagerTask<Type>::EagerTask(typename Task<Type>::promise_type* promise) noexcept
+		: Task<Type>{ promise } {}
+
+	// Task の promise_type と同じフレームを使い、 initial_suspend で中断しないことだけが異なる
+	template <class Type>
+	class EagerTask<Type>::promise_type : public Task<Type>::promise_type
+	{
+	public:
+		EagerTask get_return_object()
+		{
+			this->handle = std::coroutine_handle<promise_type>::from_promise(*this);
+			return EagerTask{ this };
+		}
+		std::suspend_never initial_suspend() noexcept
+		{
+			detail::TaskQueueImpl::AttachEager(*this);
+			return {};
+		}
+	};
+}
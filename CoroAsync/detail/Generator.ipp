@@ -0,0 +1,372 @@
+﻿# pragma once
+
+namespace cra
+{
+	namespace detail
+	{
+		// Generator と AsyncGenerator の promise_type の共通部分
+		// co_yield された値へのポインタと、コルーチンを終了させた例外を保持する
+		// Derived::yieldTo で、値を取り出す側に切り替える
+		template <class Derived, class Type>
+		class GeneratorPromiseBase
+		{
+		public:
+			using element_type = std::remove_reference_t<Type>;
+			using value_type = std::remove_cvref_t<Type>;
+
+			// co_yield の awaiter
+			class YieldAwaiter
+			{
+			public:
+				bool await_ready() const noexcept
+				{
+					return false;
+				}
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Derived> h) noexcept
+				{
+					return h.promise().yieldTo();
+				}
+				void await_resume() const noexcept {}
+			};
+
+			// const 左辺値を co_yield したときの awaiter
+			// コピーをコルーチンフレーム内の awaiter に置き、そのポインタを渡す
+			class CopyYieldAwaiter : public YieldAwaiter
+			{
+			public:
+				explicit CopyYieldAwaiter(const value_type& value)
+					: m_copy{ value } {}
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Derived> h) noexcept
+				{
+					h.promise().m_value = std::addressof(m_copy);
+					return YieldAwaiter::await_suspend(h);
+				}
+
+			private:
+				value_type m_copy;
+			};
+
+			YieldAwaiter yield_value(element_type& value) noexcept
+			{
+				m_value = std::addressof(value);
+				return YieldAwaiter{};
+			}
+			// 一時オブジェクトは co_yield を含む完全式の終わりまで、つまり次に再開されるまで生存する
+			YieldAwaiter yield_value(element_type&& value) noexcept
+			{
+				m_value = std::addressof(value);
+				return YieldAwaiter{};
+			}
+			CopyYieldAwaiter yield_value(const value_type& value) requires (not std::is_const_v<element_type>)
+			{
+				return CopyYieldAwaiter{ value };
+			}
+			void return_void() noexcept {}
+			void unhandled_exception() noexcept
+			{
+				m_exception = std::current_exception();
+			}
+
+			[[nodiscard]]
+			element_type* value() const noexcept
+			{
+				return m_value;
+			}
+
+			// コルーチンが例外で終了していれば、その例外を再送出する
+			void rethrowIfFailed()
+			{
+				if (m_exception)
+				{
+					std::rethrow_exception(std::exchange(m_exception, nullptr));
+				}
+			}
+
+		private:
+			element_type* m_value = nullptr;
+			std::exception_ptr m_exception;
+		};
+
+		// AsyncGenerator::next の awaiter
+		// 値を取り出すタスクを待機させ、対称転送でジェネレータのコルーチンを再開する
+		// 待機中にタスクが破棄された場合は、デストラクタでジェネレータとのつながりを切る
+		template <class Type>
+		class AsyncGeneratorNextAwaiter
+		{
+		public:
+			using Promise = typename AsyncGenerator<Type>::promise_type;
+
+			explicit AsyncGeneratorNextAwaiter(Promise* promise) noexcept
+				: m_promise{ promise } {}
+			AsyncGeneratorNextAwaiter(const AsyncGeneratorNextAwaiter&) = default;
+			~AsyncGeneratorNextAwaiter()
+			{
+				if (m_suspended)
+				{
+					m_promise->m_consumer = nullptr;
+				}
+			}
+			AsyncGeneratorNextAwaiter& operator =(const AsyncGeneratorNextAwaiter&) = delete;
+			bool await_ready() const noexcept
+			{
+				return (not m_promise) || (m_promise->state == TaskState::Done);
+			}
+			template <class ConsumerPromise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<ConsumerPromise> h)
+			{
+				TaskNode& node = h.promise();
+				// スレッドプールなどで実行中のタスクは、ジェネレータを実行するタスクキューを持たない
+				if (node.scheduler)
+				{
+					throw std::system_error{ std::make_error_code(std::errc::operation_not_supported) };
+				}
+				auto& generator = *m_promise;
+				generator.m_consumer = &node;
+				generator.queue = node.queue;
+				node.state = TaskState::Waiting;
+				m_suspended = true;
+				// 前に値を取り出していたタスクが破棄され、ジェネレータが待機の途中であれば、その完了を待つ
+				if (generator.state != TaskState::Idle)
+				{
+					return std::noop_coroutine();
+				}
+				return TaskQueueImpl::Start(generator);
+			}
+			typename AsyncGenerator<Type>::pointer await_resume()
+			{
+				if (not m_promise)
+				{
+					return nullptr;
+				}
+				if (std::exchange(m_suspended, false))
+				{
+					m_promise->m_consumer = nullptr;
+				}
+				m_promise->rethrowIfFailed();
+				return (m_promise->state == TaskState::Done) ? nullptr : m_promise->value();
+			}
+
+		private:
+			Promise* m_promise;
+			bool m_suspended = false;
+		};
+	}
+
+	template <class Type>
+	class Generator<Type>::promise_type : public detail::FrameAllocated, public detail::GeneratorPromiseBase<promise_type, Type>
+	{
+	public:
+		Generator get_return_object()
+		{
+			return Generator{ Handle::from_promise(*this) };
+		}
+		std::suspend_always initial_suspend() const noexcept
+		{
+			return {};
+		}
+		std::suspend_always final_suspend() const noexcept
+		{
+			return {};
+		}
+		template <class U>
+		void await_transform(U&&) = delete;
+
+		// co_yield で中断したら、 resume の呼び出し元に戻る
+		std::coroutine_handle<> yieldTo() const noexcept
+		{
+			return std::noop_coroutine();
+		}
+	};
+
+	template <class Type>
+	inline Generator<Type>::iterator::iterator(std::coroutine_handle<promise_type> coro) noexcept
+		: m_coro{ coro } {}
+
+	template <class Type>
+	inline typename Generator<Type>::reference Generator<Type>::iterator::operator *() const noexcept
+	{
+		return *m_coro.promise().value();
+	}
+
+	template <class Type>
+	inline typename Generator<Type>::pointer Generator<Type>::iterator::operator ->() const noexcept
+	{
+		return m_coro.promise().value();
+	}
+
+	template <class Type>
+	inline typename Generator<Type>::iterator& Generator<Type>::iterator::operator ++()
+	{
+		m_coro.resume();
+		m_coro.promise().rethrowIfFailed();
+		return *this;
+	}
+
+	template <class Type>
+	inline void Generator<Type>::iterator::operator ++(int)
+	{
+		++*this;
+	}
+
+	template <class Type>
+	inline Generator<Type>::Generator() noexcept
+		: m_coro{ nullptr } {}
+
+	template <class Type>
+	inline Generator<Type>::Generator(Handle h) noexcept
+		: m_coro{ h } {}
+
+	template <class Type>
+	inline Generator<Type>::Generator(Generator&& other) noexcept
+		: m_coro{ std::exchange(other.m_coro, nullptr) } {}
+
+	template <class Type>
+	inline Generator<Type>::~Generator()
+	{
+		if (m_coro)
+		{
+			m_coro.destroy();
+		}
+	}
+
+	template <class Type>
+	inline Generator<Type>& Generator<Type>::operator =(Generator&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (m_coro)
+			{
+				m_coro.destroy();
+			}
+			m_coro = std::exchange(other.m_coro, nullptr);
+		}
+		return *this;
+	}
+
+	template <class Type>
+	inline typename Generator<Type>::iterator Generator<Type>::begin()
+	{
+		if (m_coro)
+		{
+			m_coro.resume();
+			m_coro.promise().rethrowIfFailed();
+		}
+		return iterator{ m_coro };
+	}
+
+	template <class Type>
+	inline std::default_sentinel_t Generator<Type>::end() const noexcept
+	{
+		return std::default_sentinel;
+	}
+
+	template <class Type>
+	class AsyncGenerator<Type>::promise_type : public detail::PromiseBase, public detail::GeneratorPromiseBase<promise_type, Type>
+	{
+	public:
+		// final_suspend の awaiter
+		// 値を取り出すタスクに、終了したことを伝えて再開させる
+		class FinalAwaiter
+		{
+		public:
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+			{
+				auto& promise = h.promise();
+				promise.state = detail::TaskState::Done;
+				return promise.resumeConsumer();
+			}
+			void await_resume() const noexcept {}
+		};
+
+		AsyncGenerator get_return_object()
+		{
+			handle = Handle::from_promise(*this);
+			return AsyncGenerator{ Handle::from_promise(*this) };
+		}
+		// 最初に値を取り出されるまで、タスクキューには追加しない
+		std::suspend_always initial_suspend() const noexcept
+		{
+			return {};
+		}
+		FinalAwaiter final_suspend() noexcept
+		{
+			return FinalAwaiter{};
+		}
+
+		// co_yield で中断したら、値を取り出すタスクを再開する
+		std::coroutine_handle<> yieldTo() noexcept
+		{
+			state = detail::TaskState::Idle;
+			return resumeConsumer();
+		}
+
+	private:
+		friend class detail::AsyncGeneratorNextAwaiter<Type>;
+
+		// 値を取り出すのを待っているタスク
+		detail::TaskNode* m_consumer = nullptr;
+
+		std::coroutine_handle<> resumeConsumer() noexcept
+		{
+			if (m_consumer)
+			{
+				return detail::TaskQueueImpl::Start(*m_consumer);
+			}
+			return std::noop_coroutine();
+		}
+	};
+
+	template <class Type>
+	inline AsyncGenerator<Type>::AsyncGenerator() noexcept
+		: m_coro{ nullptr } {}
+
+	template <class Type>
+	inline AsyncGenerator<Type>::AsyncGenerator(Handle h) noexcept
+		: m_coro{ h } {}
+
+	template <class Type>
+	inline AsyncGenerator<Type>::AsyncGenerator(AsyncGenerator&& other) noexcept
+		: m_coro{ std::exchange(other.m_coro, nullptr) } {}
+
+	template <class Type>
+	inline AsyncGenerator<Type>::~AsyncGenerator()
+	{
+		destroy();
+	}
+
+	template <class Type>
+	inline AsyncGenerator<Type>& AsyncGenerator<Type>::operator =(AsyncGenerator&& other) noexcept
+	{
+		destroy();
+		m_coro = std::exchange(other.m_coro, nullptr);
+		return *this;
+	}
+
+	template <class Type>
+	inline detail::AsyncGeneratorNextAwaiter<Type> AsyncGenerator<Type>::next() noexcept
+	{
+		return detail::AsyncGeneratorNextAwaiter<Type>{ m_coro ? &m_coro.promise() : nullptr };
+	}
+
+	template <class Type>
+	inline bool AsyncGenerator<Type>::isDone() const noexcept
+	{
+		return (not m_coro) || m_coro.done();
+	}
+
+	template <class Type>
+	inline void AsyncGenerator<Type>::destroy() noexcept
+	{
+		if (m_coro)
+		{
+			// スリープ中や、別のタスクの完了を待っている場合は、タスクキューから外す
+			detail::TaskQueueImpl::Remove(m_coro.promise());
+			m_coro.destroy();
+			m_coro = nullptr;
+		}
+	}
+}
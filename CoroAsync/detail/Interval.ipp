@@ -0,0 +1,108 @@
+﻿# pragma once
+
+namespace cra
+{
+	namespace detail
+	{
+		// co_await interval.next() の awaiter
+		// tick の予定の時刻が過ぎていれば実行待ちキューの末尾に移り、そうでなければ予定の時刻までスリープする
+		class IntervalAwaiter
+		{
+		public:
+			explicit IntervalAwaiter(Interval& interval) noexcept
+				: m_interval{ interval } {}
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h)
+			{
+				TaskNode& node = h.promise();
+				const auto now = TaskQueueImpl::Now(node);
+				m_deadline = m_interval.advance(now);
+				if (m_deadline <= now)
+				{
+					TaskQueueImpl::Push(node);
+				}
+				else
+				{
+					TaskQueueImpl::SleepUntil(node, m_deadline, now);
+				}
+			}
+			TaskQueue::TimePoint await_resume() const noexcept
+			{
+				return m_deadline;
+			}
+
+		private:
+			Interval& m_interval;
+			TaskQueue::TimePoint m_deadline{};
+		};
+	}
+
+	inline Interval::Interval(Duration period, MissedTickBehavior behavior) noexcept
+		: m_period{ std::max(period, Duration{ 1 }) }
+		, m_started{ false }
+		, m_behavior{ behavior } {}
+
+	inline Interval::Interval(const TimePoint& start, Duration period, MissedTickBehavior behavior) noexcept
+		: m_period{ std::max(period, Duration{ 1 }) }
+		, m_next{ start }
+		, m_started{ true }
+		, m_behavior{ behavior } {}
+
+	inline detail::IntervalAwaiter Interval::next() noexcept
+	{
+		return detail::IntervalAwaiter{ *this };
+	}
+
+	inline void Interval::reset() noexcept
+	{
+		m_started = false;
+	}
+
+	inline Interval::Duration Interval::getPeriod() const noexcept
+	{
+		return m_period;
+	}
+
+	inline void Interval::setMissedTickBehavior(MissedTickBehavior behavior) noexcept
+	{
+		m_behavior = behavior;
+	}
+
+	inline MissedTickBehavior Interval::getMissedTickBehavior() const noexcept
+	{
+		return m_behavior;
+	}
+
+	inline Interval::TimePoint Interval::advance(const TimePoint& now) noexcept
+	{
+		if (not m_started)
+		{
+			m_started = true;
+			m_next = (now + m_period);
+		}
+		const auto deadline = m_next;
+		if (now < deadline)
+		{
+			m_next += m_period;
+			return deadline;
+		}
+		// 予定の時刻に間に合わなかった場合
+		switch (m_behavior)
+		{
+		case MissedTickBehavior::Burst:
+			m_next += m_period;
+			break;
+		case MissedTickBehavior::Skip:
+			m_next += m_period * ((now - deadline) / m_period + 1);
+			break;
+		case MissedTickBehavior::Delay:
+			m_next = (now + m_period);
+			break;
+		}
+		return deadline;
+	}
+}
@@ -0,0 +1,516 @@
+﻿# pragma once
+
+namespace cra
+{
+	namespace detail
+	{
+		// I/O の準備ができたときに実行する操作
+		class IoOperation
+		{
+		public:
+			// 操作を試みる。まだ準備ができていなかった場合は false を返す
+			virtual bool perform() noexcept = 0;
+
+			TaskNode* waiter = nullptr;
+
+			// 操作が失敗した場合の errno
+			int error = 0;
+
+		protected:
+			~IoOperation() = default;
+		};
+
+		// epoll によるリアクター
+		// タスクキューごとに、最初に使われたときに作成され、そのタスクキューの Poller になる
+		class EpollReactor final : public Poller
+		{
+		public:
+			enum class Direction : std::uint8_t
+			{
+				Read,
+				Write,
+			};
+
+			EpollReactor()
+				: m_epollFd{ ::epoll_create1(EPOLL_CLOEXEC) }, m_wakeFd{ ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) }
+			{
+				if (m_epollFd < 0 || m_wakeFd < 0)
+				{
+					const auto error = errno;
+					closeAll();
+					throw std::system_error{ error, std::system_category() };
+				}
+				::epoll_event event{};
+				event.events = EPOLLIN;
+				event.data.fd = m_wakeFd;
+				if (::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event) < 0)
+				{
+					const auto error = errno;
+					closeAll();
+					throw std::system_error{ error, std::system_category() };
+				}
+			}
+
+			~EpollReactor()
+			{
+				closeAll();
+			}
+
+			EpollReactor(const EpollReactor&) = delete;
+			EpollReactor& operator =(const EpollReactor&) = delete;
+
+			// queue のリアクターを返す。なければ作成する
+			static EpollReactor& For(TaskQueueImpl& queue)
+			{
+				if (not queue.poller())
+				{
+					queue.setPoller(std::make_unique<EpollReactor>());
+				}
+				return static_cast<EpollReactor&>(*queue.poller());
+			}
+
+			// fd の準備ができるまで operation を待たせる
+			void wait(int fd, Direction direction, IoOperation& operation)
+			{
+				if (fd < 0)
+				{
+					throw std::system_error{ EBADF, std::system_category() };
+				}
+				if (static_cast<std::size_t>(fd) >= m_fds.size())
+				{
+					m_fds.resize(static_cast<std::size_t>(fd) + 1);
+				}
+				auto& slot = (direction == Direction::Read) ? m_fds[fd].reader : m_fds[fd].writer;
+				if (slot)
+				{
+					throw std::system_error{ std::make_error_code(std::errc::device_or_resource_busy) };
+				}
+				slot = &operation;
+				try
+				{
+					arm(fd);
+				}
+				catch (...)
+				{
+					slot = nullptr;
+					throw;
+				}
+				++m_pending;
+			}
+
+			// 待っている operation を取り消す
+			void cancel(int fd, IoOperation& operation) noexcept
+			{
+				if (fd < 0 || static_cast<std::size_t>(fd) >= m_fds.size())
+				{
+					return;
+				}
+				auto& state = m_fds[fd];
+				for (auto slot : { &state.reader, &state.writer })
+				{
+					if (*slot == &operation)
+					{
+						*slot = nullptr;
+						--m_pending;
+					}
+				}
+			}
+
+			bool hasPending() const noexcept override
+			{
+				return m_pending != 0;
+			}
+
+			void poll(const TaskQueue::TimePoint& absTime) override
+			{
+				int timeout = 0;
+				if (absTime == TaskQueue::TimePoint::max())
+				{
+					timeout = -1;
+				}
+				else if (const auto now = TaskQueue::Clock::now(); absTime > now)
+				{
+					timeout = static_cast<int>(std::min<std::chrono::milliseconds::rep>(std::chrono::ceil<std::chrono::milliseconds>(absTime - now).count(), INT32_MAX));
+				}
+				std::array<::epoll_event, 64> events;
+				const auto count = ::epoll_wait(m_epollFd, events.data(), static_cast<int>(events.size()), timeout);
+				for (int i = 0; i < count; ++i)
+				{
+					const auto fd = events[i].data.fd;
+					if (fd == m_wakeFd)
+					{
+						std::uint64_t value;
+						[[maybe_unused]] const auto result = ::read(m_wakeFd, &value, sizeof(value));
+						continue;
+					}
+					dispatch(fd, events[i].events);
+				}
+			}
+
+			void wake() noexcept override
+			{
+				const std::uint64_t value = 1;
+				[[maybe_unused]] const auto result = ::write(m_wakeFd, &value, sizeof(value));
+			}
+
+		private:
+			struct FdState
+			{
+				IoOperation* reader = nullptr;
+				IoOperation* writer = nullptr;
+				bool registered = false;
+			};
+
+			int m_epollFd;
+			int m_wakeFd;
+			std::vector<FdState> m_fds;
+			std::size_t m_pending = 0;
+
+			void closeAll() noexcept
+			{
+				if (m_epollFd >= 0)
+				{
+					::close(m_epollFd);
+				}
+				if (m_wakeFd >= 0)
+				{
+					::close(m_wakeFd);
+				}
+			}
+
+			// 待っている操作に合わせて、1回だけ通知されるように登録し直す
+			void arm(int fd)
+			{
+				auto& state = m_fds[fd];
+				::epoll_event event{};
+				event.events = EPOLLONESHOT;
+				if (state.reader)
+				{
+					event.events |= EPOLLIN | EPOLLRDHUP;
+				}
+				if (state.writer)
+				{
+					event.events |= EPOLLOUT;
+				}
+				event.data.fd = fd;
+				// fd が閉じられて同じ番号で作り直された場合は、登録が消えていたり残っていたりする
+				if (::epoll_ctl(m_epollFd, state.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) < 0)
+				{
+					if ((errno != ENOENT && errno != EEXIST) || ::epoll_ctl(m_epollFd, state.registered ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) < 0)
+					{
+						throw std::system_error{ errno, std::system_category() };
+					}
+				}
+				state.registered = true;
+			}
+
+			void dispatch(int fd, std::uint32_t events) noexcept
+			{
+				if (static_cast<std::size_t>(fd) >= m_fds.size())
+				{
+					return;
+				}
+				auto& state = m_fds[fd];
+				const auto complete = [&](IoOperation*& slot)
+				{
+					if (slot && slot->perform())
+					{
+						TaskQueueImpl::Push(*std::exchange(slot, nullptr)->waiter);
+						--m_pending;
+					}
+				};
+				if (events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))
+				{
+					complete(state.reader);
+				}
+				if (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+				{
+					complete(state.writer);
+				}
+				// まだ待っている操作があれば、もう一度通知されるようにする
+				if (state.reader || state.writer)
+				{
+					try
+					{
+						arm(fd);
+					}
+					catch (...)
+					{
+						// 登録し直せない場合は、エラーとして完了させる
+						const auto error = errno;
+						for (auto slot : { &state.reader, &state.writer })
+						{
+							if (*slot)
+							{
+								(*slot)->error = error;
+								TaskQueueImpl::Push(*std::exchange(*slot, nullptr)->waiter);
+								--m_pending;
+							}
+						}
+					}
+				}
+			}
+		};
+
+		// io の awaiter の共通部分
+		// 待機中にタスクが破棄された場合は、デストラクタで待機を取り消す
+		class IoAwaiterBase : public IoOperation, public CancelableWait
+		{
+		public:
+			IoAwaiterBase(int fd, EpollReactor::Direction direction) noexcept
+				: m_fd{ fd }, m_direction{ direction } {}
+			IoAwaiterBase(const IoAwaiterBase& other) noexcept
+				: IoOperation{}, CancelableWait{}, m_fd{ other.m_fd }, m_direction{ other.m_direction } {}
+			~IoAwaiterBase()
+			{
+				if (waiter)
+				{
+					m_reactor->cancel(m_fd, *this);
+				}
+			}
+			IoAwaiterBase& operator =(const IoAwaiterBase&) = delete;
+
+			// キャンセルされたら、リアクターから外す
+			void cancelWait() noexcept override
+			{
+				if (waiter)
+				{
+					m_reactor->cancel(m_fd, *this);
+					waiter = nullptr;
+				}
+			}
+
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h)
+			{
+				TaskNode& node = h.promise();
+				// スレッドプールなどで実行中のタスクは、タスクキューで待てない
+				if (node.scheduler)
+				{
+					throw std::system_error{ std::make_error_code(std::errc::operation_not_supported) };
+				}
+				m_reactor = &EpollReactor::For(*node.queue);
+				waiter = &node;
+				try
+				{
+					m_reactor->wait(m_fd, m_direction, *this);
+				}
+				catch (...)
+				{
+					waiter = nullptr;
+					throw;
+				}
+				// どのキューにも入れずに待たせ、準備ができたらリアクターがタスクキューに戻す
+				node.state = TaskState::Waiting;
+				node.cancelableWait = this;
+			}
+
+		protected:
+			int m_fd;
+			EpollReactor::Direction m_direction;
+			EpollReactor* m_reactor = nullptr;
+
+			// 再開されたので、もう取り消す必要はない
+			void resumed() noexcept
+			{
+				waiter = nullptr;
+			}
+
+			void throwIfFailed() const
+			{
+				if (error)
+				{
+					throw std::system_error{ error, std::system_category() };
+				}
+			}
+
+			// 準備ができていないことを示すエラーか
+			static bool WouldBlock(int error) noexcept
+			{
+				return error == EAGAIN || error == EWOULDBLOCK;
+			}
+		};
+
+		class IoReadinessAwaiter : public IoAwaiterBase
+		{
+		public:
+			using IoAwaiterBase::IoAwaiterBase;
+
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			void await_resume()
+			{
+				resumed();
+				throwIfFailed();
+			}
+			bool perform() noexcept override
+			{
+				return true;
+			}
+		};
+
+		class IoReadAwaiter : public IoAwaiterBase
+		{
+		public:
+			IoReadAwaiter(int fd, std::span<std::byte> buffer) noexcept
+				: IoAwaiterBase{ fd, EpollReactor::Direction::Read }, m_buffer{ buffer } {}
+
+			// 準備ができていれば、中断せずに読み込む
+			bool await_ready() noexcept
+			{
+				return perform();
+			}
+			std::size_t await_resume()
+			{
+				resumed();
+				throwIfFailed();
+				return m_result;
+			}
+			bool perform() noexcept override
+			{
+				while (true)
+				{
+					const auto result = ::read(m_fd, m_buffer.data(), m_buffer.size());
+					if (result >= 0)
+					{
+						m_result = static_cast<std::size_t>(result);
+						return true;
+					}
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					if (WouldBlock(errno))
+					{
+						return false;
+					}
+					error = errno;
+					return true;
+				}
+			}
+
+		private:
+			std::span<std::byte> m_buffer;
+			std::size_t m_result = 0;
+		};
+
+		class IoWriteAwaiter : public IoAwaiterBase
+		{
+		public:
+			IoWriteAwaiter(int fd, std::span<const std::byte> buffer) noexcept
+				: IoAwaiterBase{ fd, EpollReactor::Direction::Write }, m_buffer{ buffer } {}
+
+			// 準備ができていれば、中断せずに書き込む
+			bool await_ready() noexcept
+			{
+				return perform();
+			}
+			std::size_t await_resume()
+			{
+				resumed();
+				throwIfFailed();
+				return m_result;
+			}
+			bool perform() noexcept override
+			{
+				while (true)
+				{
+					const auto result = ::write(m_fd, m_buffer.data(), m_buffer.size());
+					if (result >= 0)
+					{
+						m_result = static_cast<std::size_t>(result);
+						return true;
+					}
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					if (WouldBlock(errno))
+					{
+						return false;
+					}
+					error = errno;
+					return true;
+				}
+			}
+
+		private:
+			std::span<const std::byte> m_buffer;
+			std::size_t m_result = 0;
+		};
+
+		class IoAcceptAwaiter : public IoAwaiterBase
+		{
+		public:
+			explicit IoAcceptAwaiter(int fd) noexcept
+				: IoAwaiterBase{ fd, EpollReactor::Direction::Read } {}
+
+			// 接続が来ていれば、中断せずに受け入れる
+			bool await_ready() noexcept
+			{
+				return perform();
+			}
+			int await_resume()
+			{
+				resumed();
+				throwIfFailed();
+				return m_result;
+			}
+			bool perform() noexcept override
+			{
+				while (true)
+				{
+					const auto result = ::accept4(m_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+					if (result >= 0)
+					{
+						m_result = result;
+						return true;
+					}
+					if (errno == EINTR || errno == ECONNABORTED)
+					{
+						continue;
+					}
+					if (WouldBlock(errno))
+					{
+						return false;
+					}
+					error = errno;
+					return true;
+				}
+			}
+
+		private:
+			int m_result = -1;
+		};
+	}
+
+	namespace io
+	{
+		inline detail::IoReadinessAwaiter Readable(int fd) noexcept
+		{
+			return detail::IoReadinessAwaiter{ fd, detail::EpollReactor::Direction::Read };
+		}
+
+		inline detail::IoReadinessAwaiter Writable(int fd) noexcept
+		{
+			return detail::IoReadinessAwaiter{ fd, detail::EpollReactor::Direction::Write };
+		}
+
+		inline detail::IoReadAwaiter Read(int fd, std::span<std::byte> buffer) noexcept
+		{
+			return detail::IoReadAwaiter{ fd, buffer };
+		}
+
+		inline detail::IoWriteAwaiter Write(int fd, std::span<const std::byte> buffer) noexcept
+		{
+			return detail::IoWriteAwaiter{ fd, buffer };
+		}
+
+		inline detail::IoAcceptAwaiter Accept(int fd) noexcept
+		{
+			return detail::IoAcceptAwaiter{ fd };
+		}
+	}
+}
@@ -0,0 +1,407 @@
+﻿# pragma once
+
+namespace cra
+{
+	namespace detail
+	{
+		// 同期プリミティブで待っているタスクを表すノード
+		// awaiter としてコルーチンフレームに置かれるため、待機中にタスクが破棄されると、デストラクタでリストから外される
+		// 待機中にタスクがキャンセルされた場合も、リストから外される
+		class SyncWaiter : public CancelableWait
+		{
+		public:
+			SyncWaiter() noexcept = default;
+
+			// リストにつながれる前にしかコピーされないので、つながりはコピーしない
+			SyncWaiter(const SyncWaiter&) noexcept
+				: CancelableWait{} {}
+
+			~SyncWaiter()
+			{
+				if (m_list)
+				{
+					m_list->erase(*this);
+				}
+			}
+
+			SyncWaiter& operator =(const SyncWaiter&) = delete;
+
+			void cancelWait() noexcept override
+			{
+				if (m_list)
+				{
+					m_list->erase(*this);
+				}
+			}
+
+		protected:
+			// 待機が解除されて、ロックなどを引き渡されたが、まだ再開していない
+			[[nodiscard]]
+			bool isGrantPending() const noexcept
+			{
+				return m_granted && not m_resumed;
+			}
+
+			// 実行中のタスクを list で待たせる
+			template <class Promise>
+			void suspendOn(SyncWaitList& list, std::coroutine_handle<Promise> h) noexcept
+			{
+				TaskNode& node = h.promise();
+				m_task = &node;
+				list.push_back(*this);
+				// どのキューにも入れずに待たせ、待機が解除されたらタスクキューに戻す
+				node.state = TaskState::Waiting;
+				node.cancelableWait = this;
+			}
+
+			void markResumed() noexcept
+			{
+				m_resumed = true;
+			}
+
+		private:
+			friend class SyncWaitList;
+
+			TaskNode* m_task = nullptr;
+			SyncWaitList* m_list = nullptr;
+			SyncWaiter* m_prev = nullptr;
+			SyncWaiter* m_next = nullptr;
+			bool m_granted = false;
+			bool m_resumed = false;
+		};
+
+		inline bool SyncWaitList::empty() const noexcept
+		{
+			return m_head == nullptr;
+		}
+
+		inline SyncWaiter* SyncWaitList::front() const noexcept
+		{
+			return m_head;
+		}
+
+		inline void SyncWaitList::push_back(SyncWaiter& waiter) noexcept
+		{
+			waiter.m_list = this;
+			waiter.m_prev = m_tail;
+			waiter.m_next = nullptr;
+			(m_tail ? m_tail->m_next : m_head) = &waiter;
+			m_tail = &waiter;
+		}
+
+		inline void SyncWaitList::erase(SyncWaiter& waiter) noexcept
+		{
+			(waiter.m_prev ? waiter.m_prev->m_next : m_head) = waiter.m_next;
+			(waiter.m_next ? waiter.m_next->m_prev : m_tail) = waiter.m_prev;
+			waiter.m_list = nullptr;
+			waiter.m_prev = nullptr;
+			waiter.m_next = nullptr;
+		}
+
+		inline void SyncWaitList::grantFront()
+		{
+			auto& waiter = *m_head;
+			erase(waiter);
+			waiter.m_granted = true;
+			TaskQueueImpl::Push(*waiter.m_task);
+		}
+
+		inline void SyncWaitList::grantAll()
+		{
+			while (m_head)
+			{
+				grantFront();
+			}
+		}
+
+		// AsyncMutex::lock の awaiter
+		// ロックを引き渡された後、再開する前にタスクが破棄された場合は、ロックを解除する
+		class MutexLockAwaiter : public SyncWaiter
+		{
+		public:
+			explicit MutexLockAwaiter(AsyncMutex& mutex) noexcept
+				: m_mutex{ mutex } {}
+			MutexLockAwaiter(const MutexLockAwaiter&) = default;
+			~MutexLockAwaiter()
+			{
+				if (isGrantPending())
+				{
+					m_mutex.unlock();
+				}
+			}
+			bool await_ready() noexcept
+			{
+				return m_mutex.try_lock();
+			}
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				suspendOn(m_mutex.m_waiters, h);
+			}
+			void await_resume() noexcept
+			{
+				markResumed();
+			}
+
+		protected:
+			AsyncMutex& m_mutex;
+		};
+
+		// AsyncMutex::scopedLock の awaiter
+		class MutexScopedLockAwaiter : public MutexLockAwaiter
+		{
+		public:
+			using MutexLockAwaiter::MutexLockAwaiter;
+
+			AsyncMutexLock await_resume() noexcept
+			{
+				MutexLockAwaiter::await_resume();
+				return AsyncMutexLock{ m_mutex };
+			}
+		};
+
+		// AsyncSemaphore::acquire の awaiter
+		// 引き渡された後、再開する前にタスクが破棄された場合は、カウンタを戻す
+		class SemaphoreAcquireAwaiter : public SyncWaiter
+		{
+		public:
+			explicit SemaphoreAcquireAwaiter(AsyncSemaphore& semaphore) noexcept
+				: m_semaphore{ semaphore } {}
+			SemaphoreAcquireAwaiter(const SemaphoreAcquireAwaiter&) = default;
+			~SemaphoreAcquireAwaiter()
+			{
+				if (isGrantPending())
+				{
+					m_semaphore.release();
+				}
+			}
+			bool await_ready() noexcept
+			{
+				return m_semaphore.try_acquire();
+			}
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				suspendOn(m_semaphore.m_waiters, h);
+			}
+			void await_resume() noexcept
+			{
+				markResumed();
+			}
+
+		private:
+			AsyncSemaphore& m_semaphore;
+		};
+
+		// ManualResetEvent::wait の awaiter
+		class ManualResetEventAwaiter : public SyncWaiter
+		{
+		public:
+			ManualResetEventAwaiter(SyncWaitList& waiters, const bool& set) noexcept
+				: m_waiters{ waiters }, m_set{ set } {}
+			ManualResetEventAwaiter(const ManualResetEventAwaiter&) = default;
+			bool await_ready() const noexcept
+			{
+				return m_set;
+			}
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				suspendOn(m_waiters, h);
+			}
+			void await_resume() const noexcept {}
+
+		private:
+			SyncWaitList& m_waiters;
+			const bool& m_set;
+		};
+
+		// AsyncEvent::wait の awaiter
+		// シグナルを引き渡された後、再開する前にタスクが破棄された場合は、シグナルを戻す
+		class AsyncEventAwaiter : public SyncWaiter
+		{
+		public:
+			explicit AsyncEventAwaiter(AsyncEvent& event) noexcept
+				: m_event{ event } {}
+			AsyncEventAwaiter(const AsyncEventAwaiter&) = default;
+			~AsyncEventAwaiter()
+			{
+				if (isGrantPending())
+				{
+					m_event.set();
+				}
+			}
+			bool await_ready() noexcept
+			{
+				return std::exchange(m_event.m_set, false);
+			}
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				suspendOn(m_event.m_waiters, h);
+			}
+			void await_resume() noexcept
+			{
+				markResumed();
+			}
+
+		private:
+			AsyncEvent& m_event;
+		};
+	}
+
+	inline AsyncMutexLock::AsyncMutexLock(AsyncMutex& mutex) noexcept
+		: m_mutex{ &mutex } {}
+
+	inline AsyncMutexLock::AsyncMutexLock(AsyncMutexLock&& other) noexcept
+		: m_mutex{ std::exchange(other.m_mutex, nullptr) } {}
+
+	inline AsyncMutexLock::~AsyncMutexLock()
+	{
+		unlock();
+	}
+
+	inline AsyncMutexLock& AsyncMutexLock::operator =(AsyncMutexLock&& other) noexcept
+	{
+		if (this != &other)
+		{
+			unlock();
+			m_mutex = std::exchange(other.m_mutex, nullptr);
+		}
+		return *this;
+	}
+
+	inline bool AsyncMutexLock::ownsLock() const noexcept
+	{
+		return m_mutex != nullptr;
+	}
+
+	inline void AsyncMutexLock::unlock()
+	{
+		if (m_mutex)
+		{
+			std::exchange(m_mutex, nullptr)->unlock();
+		}
+	}
+
+	inline detail::MutexLockAwaiter AsyncMutex::lock() noexcept
+	{
+		return detail::MutexLockAwaiter{ *this };
+	}
+
+	inline detail::MutexScopedLockAwaiter AsyncMutex::scopedLock() noexcept
+	{
+		return detail::MutexScopedLockAwaiter{ *this };
+	}
+
+	inline bool AsyncMutex::try_lock() noexcept
+	{
+		if (m_locked)
+		{
+			return false;
+		}
+		m_locked = true;
+		return true;
+	}
+
+	inline void AsyncMutex::unlock()
+	{
+		// 待っているタスクがあれば、ロックしたまま所有権を引き渡す
+		if (m_waiters.empty())
+		{
+			m_locked = false;
+			return;
+		}
+		m_waiters.grantFront();
+	}
+
+	inline bool AsyncMutex::isLocked() const noexcept
+	{
+		return m_locked;
+	}
+
+	inline AsyncSemaphore::AsyncSemaphore(std::ptrdiff_t count) noexcept
+		: m_count{ count } {}
+
+	inline detail::SemaphoreAcquireAwaiter AsyncSemaphore::acquire() noexcept
+	{
+		return detail::SemaphoreAcquireAwaiter{ *this };
+	}
+
+	inline bool AsyncSemaphore::try_acquire() noexcept
+	{
+		if (m_count <= 0)
+		{
+			return false;
+		}
+		--m_count;
+		return true;
+	}
+
+	inline void AsyncSemaphore::release(std::ptrdiff_t update)
+	{
+		for (; update > 0 && not m_waiters.empty(); --update)
+		{
+			m_waiters.grantFront();
+		}
+		m_count += update;
+	}
+
+	inline std::ptrdiff_t AsyncSemaphore::available() const noexcept
+	{
+		return m_count;
+	}
+
+	inline ManualResetEvent::ManualResetEvent(bool initiallySet) noexcept
+		: m_set{ initiallySet } {}
+
+	inline detail::ManualResetEventAwaiter ManualResetEvent::wait() noexcept
+	{
+		return detail::ManualResetEventAwaiter{ m_waiters, m_set };
+	}
+
+	inline void ManualResetEvent::set()
+	{
+		m_set = true;
+		m_waiters.grantAll();
+	}
+
+	inline void ManualResetEvent::reset() noexcept
+	{
+		m_set = false;
+	}
+
+	inline bool ManualResetEvent::isSet() const noexcept
+	{
+		return m_set;
+	}
+
+	inline AsyncEvent::AsyncEvent(bool initiallySet) noexcept
+		: m_set{ initiallySet } {}
+
+	inline detail::AsyncEventAwaiter AsyncEvent::wait() noexcept
+	{
+		return detail::AsyncEventAwaiter{ *this };
+	}
+
+	inline void AsyncEvent::set()
+	{
+		// 待っているタスクがあれば、シグナル状態にする代わりに先頭の1つに引き渡す
+		if (m_waiters.empty())
+		{
+			m_set = true;
+			return;
+		}
+		m_waiters.grantFront();
+	}
+
+	inline void AsyncEvent::reset() noexcept
+	{
+		m_set = false;
+	}
+
+	inline bool AsyncEvent::isSet() const noexcept
+	{
+		return m_set;
+	}
+}
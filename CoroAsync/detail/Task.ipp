@@ -4,47 +4,487 @@ namespace cra
 {
 	namespace detail
 	{
-	# ifdef __GNUC__
+		// PromiseBase の基底クラス
+		// コルーチンフレームをタスクキューのフレームプールから確保する
+		// コルーチンの引数の先頭（メンバ関数ではオブジェクトの次）に std::allocator_arg とアロケータを渡した場合は、そのアロケータで確保する
+		class FrameAllocated
+		{
+		public:
+			static void* operator new(std::size_t size)
+			{
+				return TaskQueueImpl::AllocateFrame(size);
+			}
+			template <class Alloc, class... Args>
+			static void* operator new(std::size_t size, std::allocator_arg_t, const Alloc& alloc, const Args&...)
+			{
+				return AllocateFrameWith(size, alloc);
+			}
+			template <class This, class Alloc, class... Args>
+			static void* operator new(std::size_t size, const This&, std::allocator_arg_t, const Alloc& alloc, const Args&...)
+			{
+				return AllocateFrameWith(size, alloc);
+			}
+			static void operator delete(void* frame, std::size_t size) noexcept
+			{
+				const auto& trailer = GetFrameTrailer(frame, size);
+				trailer.deallocate(trailer.context, frame, size);
+			}
+
+		private:
+			// アロケータから確保する単位。コルーチンフレームに必要なアライメントを保証する
+			struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) FrameBlock
+			{
+				std::byte data[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+			};
+
+			template <class Alloc>
+			using BlockAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<FrameBlock>;
 
-		// GCC のバグ対策
+			// フレーム、 FrameTrailer 、アロケータのコピーの順に配置する
+			template <class BlockAlloc>
+			static constexpr std::size_t AllocatorOffset(std::size_t size) noexcept
+			{
+				const auto end = FrameTrailerOffset(size) + sizeof(FrameTrailer);
+				return (end + alignof(BlockAlloc) - 1) / alignof(BlockAlloc) * alignof(BlockAlloc);
+			}
+			template <class BlockAlloc>
+			static constexpr std::size_t BlockCount(std::size_t size) noexcept
+			{
+				return (AllocatorOffset<BlockAlloc>(size) + sizeof(BlockAlloc) + sizeof(FrameBlock) - 1) / sizeof(FrameBlock);
+			}
+
+			template <class Alloc>
+			static void* AllocateFrameWith(std::size_t size, const Alloc& alloc)
+			{
+				using BlockAlloc = BlockAllocator<Alloc>;
+				BlockAlloc blockAlloc{ alloc };
+				auto* frame = static_cast<std::byte*>(static_cast<void*>(std::allocator_traits<BlockAlloc>::allocate(blockAlloc, BlockCount<BlockAlloc>(size))));
+				::new (frame + FrameTrailerOffset(size)) FrameTrailer{ &DeallocateFrameWith<BlockAlloc>, nullptr };
+				::new (frame + AllocatorOffset<BlockAlloc>(size)) BlockAlloc{ std::move(blockAlloc) };
+				TaskQueueImpl::GetFramePool().countExternalAllocation();
+				return frame;
+			}
+
+			template <class BlockAlloc>
+			static void DeallocateFrameWith(void*, void* frame, std::size_t size) noexcept
+			{
+				auto* stored = std::launder(reinterpret_cast<BlockAlloc*>(static_cast<std::byte*>(frame) + AllocatorOffset<BlockAlloc>(size)));
+				BlockAlloc blockAlloc{ std::move(*stored) };
+				stored->~BlockAlloc();
+				std::allocator_traits<BlockAlloc>::deallocate(blockAlloc, static_cast<FrameBlock*>(frame), BlockCount<BlockAlloc>(size));
+				TaskQueueImpl::GetFramePool().countExternalDeallocation();
+			}
+		};
+
+		// コルーチンフレーム内に置かれるタスクの結果の格納先
+		// シングルスレッドでしか使われないため、 std::promise のような共有状態や排他制御は持たない
 		template <class Type>
-		struct AwaiterWrapper
+		class TaskResult
 		{
-			Type m_awaiter;
-			decltype(auto) await_ready()
-				noexcept(noexcept(m_awaiter.await_ready()))
+		public:
+			template <class U>
+			void set_value(U&& value)
 			{
-				return m_awaiter.await_ready();
+				m_result.template emplace<1>(std::forward<U>(value));
 			}
-			decltype(auto) await_suspend(std::coroutine_handle<> h)
-				noexcept(noexcept(m_awaiter.await_suspend(h)))
+			void set_exception(std::exception_ptr e) noexcept
 			{
-				return m_awaiter.await_suspend(h);
+				m_result.template emplace<2>(std::move(e));
+			}
+			[[nodiscard]]
+			bool isRetrieved() const noexcept
+			{
+				return m_retrieved;
+			}
+			Type get()
+			{
+				// 2回目以降は、結果をムーブした後なので取り出せない
+				if (std::exchange(m_retrieved, true))
+				{
+					throw std::future_error{ std::future_errc::no_state };
+				}
+				if (m_result.index() == 2)
+				{
+					std::rethrow_exception(std::get<2>(m_result));
+				}
+				if (m_result.index() == 0)
+				{
+					throw std::future_error{ std::future_errc::no_state };
+				}
+				return static_cast<Type>(std::move(std::get<1>(m_result)));
+			}
+
+		private:
+			// 参照型の結果は std::reference_wrapper に包んで保持する
+			using StorageType = std::conditional_t<std::is_lvalue_reference_v<Type>, std::reference_wrapper<std::remove_reference_t<Type>>, Type>;
+
+			std::variant<std::monostate, StorageType, std::exception_ptr> m_result;
+			bool m_retrieved = false;
+		};
+
+		template <>
+		class TaskResult<void>
+		{
+		public:
+			void set_value() noexcept
+			{
+				m_completed = true;
+			}
+			void set_exception(std::exception_ptr e) noexcept
+			{
+				m_exception = std::move(e);
+			}
+			[[nodiscard]]
+			bool isRetrieved() const noexcept
+			{
+				return m_retrieved;
+			}
+			void get()
+			{
+				if (std::exchange(m_retrieved, true))
+				{
+					throw std::future_error{ std::future_errc::no_state };
+				}
+				if (m_exception)
+				{
+					std::rethrow_exception(m_exception);
+				}
+				if (not m_completed)
+				{
+					throw std::future_error{ std::future_errc::no_state };
+				}
+			}
+
+		private:
+			std::exception_ptr m_exception;
+			bool m_completed = false;
+			bool m_retrieved = false;
+		};
+
+		// co_await relTime の awaiter
+		// relTime が 0 以下の場合は、タスクキューの末尾に追加し直す
+		class SleepAwaiter
+		{
+		public:
+			SleepAwaiter(TaskNode& self, TaskQueue::Clock::duration relTime) noexcept
+				: m_self{ self }, m_relTime{ relTime } {}
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			void await_suspend(std::coroutine_handle<>)
+			{
+				if (m_relTime.count() > 0)
+				{
+					TaskQueueImpl::SleepFor(m_self, m_relTime);
+				}
+				else
+				{
+					TaskQueueImpl::Push(m_self);
+				}
+			}
+			void await_resume() const noexcept {}
+
+		private:
+			TaskNode& m_self;
+			TaskQueue::Clock::duration m_relTime;
+		};
+
+		// co_await NextFrame(phase) と co_await Frames(count, phase) の awaiter
+		// タスクキューの phase の段階の待機リストに追加し、フレームが進むのを待つ
+		class NextFrameAwaiter
+		{
+		public:
+			NextFrameAwaiter(std::uint32_t count, FramePhase phase) noexcept
+				: m_count{ count }, m_phase{ phase } {}
+			bool await_ready() const noexcept
+			{
+				return (m_count == 0);
+			}
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h)
+			{
+				TaskQueueImpl::WaitFrames(h.promise(), m_count, m_phase);
+			}
+			void await_resume() const noexcept {}
+
+		private:
+			std::uint32_t m_count;
+			FramePhase m_phase;
+		};
+
+		// co_await task の awaiter
+		// 待機のレコードを持ち、待たれるタスクの待機リストにつなぐ
+		template <class TaskRef>
+		class TaskAwaiter
+		{
+		public:
+			TaskAwaiter(TaskRef task, TaskNode& self, TaskNode* target) noexcept
+				: m_task{ std::forward<TaskRef>(task) }, m_self{ self }, m_record{ .target = target } {}
+			bool await_ready() const noexcept
+			{
+				return (not m_record.target) || TaskQueueImpl::IsDone(*m_record.target);
+			}
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept
+			{
+				return TaskQueueImpl::Wait(m_self, &m_record, 1, 1);
+			}
+			decltype(auto) await_resume()
+			{
+				return m_task.get();
+			}
+
+		private:
+			TaskRef m_task;
+			TaskNode& m_self;
+			WaitRecord m_record;
+		};
+
+		// initial_suspend の awaiter
+		// 中断してから、作成されたタスクをスケジューラに追加する
+		// 別のスレッドのスケジューラは、追加された時点でタスクを再開しうるため
+		class InitialAwaiter
+		{
+		public:
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				TaskQueueImpl::Spawn(h.promise());
+			}
+			void await_resume() const noexcept {}
+		};
+
+		// final_suspend の awaiter
+		// タスクの完了を待っているタスクを再開させる
+		class FinalAwaiter
+		{
+		public:
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			template <class Promise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				auto& node = h.promise();
+				// スケジューラのタスクは Complete の中で破棄されることがあるので、先に確認しておく
+				const bool detached = (not node.scheduler && node.detached);
+				const auto next = TaskQueueImpl::Complete(node);
+				// 手放されたタスクは、ここでコルーチンフレームを破棄する
+				if (detached && TaskQueueImpl::Remove(node))
+				{
+					h.destroy();
+				}
+				return next;
+			}
+			void await_resume() const noexcept {}
+		};
+
+		// co_await SetPriority(priority) の awaiter
+		// 中断せずに、実行中のタスクの優先度を変更する
+		class SetPriorityAwaiter
+		{
+		public:
+			explicit SetPriorityAwaiter(TaskPriority priority) noexcept
+				: m_priority{ priority } {}
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			template <class Promise>
+			bool await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				TaskQueueImpl::SetPriority(h.promise(), m_priority);
+				return false;
+			}
+			void await_resume() const noexcept {}
+
+		private:
+			TaskPriority m_priority;
+		};
+
+		// co_await SetName(name) の awaiter
+		// 中断せずに、実行中のタスクの名前を設定する
+		class SetNameAwaiter
+		{
+		public:
+			explicit SetNameAwaiter(const char* name) noexcept
+				: m_name{ name } {}
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			template <class Promise>
+			bool await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				TaskQueueImpl::SetName(h.promise(), m_name);
+				return false;
+			}
+			void await_resume() const noexcept {}
+
+		private:
+			const char* m_name;
+		};
+
+		// co_await SetCancellationToken(token) の awaiter
+		// 中断せずに、実行中のタスクにトークンを結びつける
+		class SetCancellationTokenAwaiter
+		{
+		public:
+			explicit SetCancellationTokenAwaiter(CancellationToken&& token) noexcept
+				: m_token{ std::move(token) } {}
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			template <class Promise>
+			bool await_suspend(std::coroutine_handle<Promise> h)
+			{
+				TaskQueueImpl::SetCancellation(h.promise(), m_token.m_state);
+				return false;
+			}
+			void await_resume() const noexcept {}
+
+		private:
+			CancellationToken m_token;
+		};
+
+		// 中断している間に操作が成立したかを isCompleted で返す awaiter
+		// 成立した操作は取り消せないので、キャンセルされていても結果を返す
+		template <class Type>
+		concept CompletionAwareAwaiter = requires (const Type& awaiter)
+		{
+			{ awaiter.isCompleted() } -> std::convertible_to<bool>;
+		};
+
+		// co_await 式でキャンセルを確認する awaiter
+		// キャンセルされたタスクでは中断せず、 await_resume で OperationCanceled を投げる
+		template <class Inner>
+		class CancelCheckAwaiter
+		{
+		public:
+			template <class... Args>
+			explicit CancelCheckAwaiter(const TaskNode& self, Args&&... args)
+				: m_self{ self }, m_inner{ std::forward<Args>(args)... } {}
+			bool await_ready()
+			{
+				return m_self.canceled || m_inner.await_ready();
+			}
+			template <class Promise>
+			decltype(auto) await_suspend(std::coroutine_handle<Promise> h)
+			{
+				return m_inner.await_suspend(h);
 			}
 			decltype(auto) await_resume()
-				noexcept(noexcept(m_awaiter.await_resume()))
 			{
-				return m_awaiter.await_resume();
+				if constexpr (CompletionAwareAwaiter<Inner>)
+				{
+					if (m_self.canceled && not m_inner.isCompleted())
+					{
+						throw OperationCanceled{};
+					}
+				}
+				else if (m_self.canceled)
+				{
+					throw OperationCanceled{};
+				}
+				return m_inner.await_resume();
 			}
+
+		private:
+			const TaskNode& m_self;
+			Inner m_inner;
 		};
 
-	# endif
+		template <class Type>
+		struct IsTask : std::false_type {};
+		template <class Type>
+		struct IsTask<Task<Type>> : std::true_type {};
+
+		// await_transform でそのまま使う awaiter
+		// awaiter は await_suspend で std::coroutine_handle<Promise> を受け取り、 Promise から TaskNode を得る
+		template <class Type>
+		concept Awaiter = (not IsTask<Type>::value) && requires (Type& awaiter)
+		{
+			{ awaiter.await_ready() } -> std::convertible_to<bool>;
+			awaiter.await_resume();
+		};
+
+		// Task の promise_type の共通部分
+		class PromiseBase : public FrameAllocated, public TaskNode
+		{
+		public:
+			InitialAwaiter initial_suspend() noexcept
+			{
+				return InitialAwaiter{};
+			}
+			FinalAwaiter final_suspend() noexcept
+			{
+				return FinalAwaiter{};
+			}
+
+			template <class Rep, class Period>
+			CancelCheckAwaiter<SleepAwaiter> await_transform(const std::chrono::duration<Rep, Period>& relTime)
+			{
+				return CancelCheckAwaiter<SleepAwaiter>{ *this, *this, std::chrono::ceil<TaskQueue::Clock::duration>(relTime) };
+			}
+			CancelCheckAwaiter<SleepAwaiter> await_transform(std::uint32_t relTime)
+			{
+				return await_transform(std::chrono::milliseconds{ relTime });
+			}
+			template <class U>
+			CancelCheckAwaiter<TaskAwaiter<Task<U>&>> await_transform(Task<U>& task)
+			{
+				return CancelCheckAwaiter<TaskAwaiter<Task<U>&>>{ *this, task, *this, GetNode(task) };
+			}
+			template <class U>
+			CancelCheckAwaiter<TaskAwaiter<Task<U>&&>> await_transform(Task<U>&& task)
+			{
+				return CancelCheckAwaiter<TaskAwaiter<Task<U>&&>>{ *this, std::move(task), *this, GetNode(task) };
+			}
+			template <Awaiter Type>
+			CancelCheckAwaiter<Type> await_transform(Type awaiter) noexcept(std::is_nothrow_move_constructible_v<Type>)
+			{
+				return CancelCheckAwaiter<Type>{ *this, std::move(awaiter) };
+			}
+			// タスクの設定を変える awaiter は、キャンセルされたタスクでも使える
+			SetPriorityAwaiter await_transform(SetPriorityAwaiter awaiter) noexcept
+			{
+				return awaiter;
+			}
+			SetCancellationTokenAwaiter await_transform(SetCancellationTokenAwaiter awaiter) noexcept
+			{
+				return awaiter;
+			}
+			SetNameAwaiter await_transform(SetNameAwaiter awaiter) noexcept
+			{
+				return awaiter;
+			}
+
+			// タスクの TaskNode を返す。タスクが空の場合は nullptr を返す
+			template <class U>
+			static TaskNode* GetNode(const Task<U>& task) noexcept
+			{
+				return task.m_promise;
+			}
+		};
 	}
 
 	template <class Type>
 	inline Task<Type>::Task() noexcept
-		: m_coro{ nullptr }, m_result{} {}
+		: m_promise{ nullptr } {}
 
 	template <class Type>
-	inline Task<Type>::Task(Handle h, std::future<Type> f) noexcept
-		: m_coro{ h }, m_result{ std::move(f) }
-	{
-		detail::TaskQueueImpl::Push(m_coro);
-	}
+	inline Task<Type>::Task(promise_type* promise) noexcept
+		: m_promise{ promise } {}
 
 	template <class Type>
 	inline Task<Type>::Task(Task&& other) noexcept
-		: m_coro{ std::exchange(other.m_coro, nullptr) }, m_result{ std::move(other.m_result) } {}
+		: m_promise{ std::exchange(other.m_promise, nullptr) } {}
 
 	template <class Type>
 	inline Task<Type>::~Task()
@@ -56,28 +496,32 @@ namespace cra
 	inline Task<Type>& Task<Type>::operator =(Task&& other) noexcept
 	{
 		destroy();
-		m_coro = std::exchange(other.m_coro, nullptr);
-		m_result = std::move(other.m_result);
+		m_promise = std::exchange(other.m_promise, nullptr);
 		return *this;
 	}
 
 	template <class Type>
 	inline bool Task<Type>::isValid() const noexcept
 	{
-		return m_coro && m_result.valid();
+		return m_promise && not m_promise->result().isRetrieved();
 	}
 
 	template <class Type>
 	inline bool Task<Type>::isReady() const noexcept
 	{
-		return isValid() && m_coro.done();
+		return isValid() && detail::TaskQueueImpl::IsDone(*m_promise);
 	}
 
 	template <class Type>
 	inline Type Task<Type>::get()
 	{
+		// 空のタスクや、結果を取得済みのタスクは std::future と同じく例外を投げる
+		if (not isValid())
+		{
+			throw std::future_error{ std::future_errc::no_state };
+		}
 		wait();
-		return m_result.get();
+		return m_promise->result().get();
 	}
 
 	template <class Type>
@@ -90,6 +534,11 @@ namespace cra
 	template <class Rep, class Period>
 	inline std::future_status Task<Type>::wait_for(const std::chrono::duration<Rep, Period>& relTime)
 	{
+		// タスクキューで実行されるタスクは、タスクキューの現在時刻を基準にする
+		if (m_promise && not m_promise->scheduler)
+		{
+			return wait_until(m_promise->queue->owner().now() + relTime);
+		}
 		return wait_until(detail::TaskQueueImpl::Clock::now() + relTime);
 	}
 
@@ -97,21 +546,71 @@ namespace cra
 	template <class Clock, class Duration>
 	inline std::future_status Task<Type>::wait_until(const std::chrono::time_point<Clock, Duration>& absTime)
 	{
-		detail::TaskQueueImpl::RunUntil(m_coro, absTime);
-		return m_coro.done() ? std::future_status::ready : std::future_status::timeout;
+		if (not m_promise)
+		{
+			return std::future_status::timeout;
+		}
+		auto& node = *m_promise;
+		// 完了済みの場合は、タスクキューを回さない
+		if (not node.scheduler && not detail::TaskQueueImpl::IsDone(node))
+		{
+			node.queue->runUntil(&node, absTime);
+		}
+		// 別のスケジューラで実行されている場合は、その完了を待つ
+		if (node.scheduler && not detail::TaskQueueImpl::IsDone(node))
+		{
+			node.scheduler->waitUntil(node, absTime);
+		}
+		return detail::TaskQueueImpl::IsDone(node) ? std::future_status::ready : std::future_status::timeout;
 	}
 
 	template <class Type>
 	inline void Task<Type>::destroy() noexcept
 	{
-		if (m_coro)
+		if (m_promise)
+		{
+			// 別のスレッドで実行中のタスクは、スケジューラが後で破棄する
+			if (detail::TaskQueueImpl::Remove(*m_promise))
+			{
+				m_promise->handle.destroy();
+			}
+			m_promise = nullptr;
+		}
+	}
+
+	template <class Type>
+	inline void Task<Type>::setPriority(TaskPriority priority) noexcept
+	{
+		if (m_promise)
+		{
+			detail::TaskQueueImpl::SetPriority(*m_promise, priority);
+		}
+	}
+
+	template <class Type>
+	inline void Task<Type>::setCancellationToken(const CancellationToken& token)
+	{
+		if (m_promise)
+		{
+			detail::TaskQueueImpl::SetCancellation(*m_promise, token.m_state);
+		}
+	}
+
+	template <class Type>
+	inline void Task<Type>::setName(const char* name) noexcept
+	{
+		if (m_promise)
 		{
-			detail::TaskQueueImpl::Remove(m_coro);
-			m_coro.destroy();
-			m_coro = nullptr;
+			detail::TaskQueueImpl::SetName(*m_promise, name);
 		}
 	}
 
+	template <class Type>
+	inline TaskTraceInfo Task<Type>::getTraceInfo() const noexcept
+	{
+		return m_promise ? detail::TaskQueueImpl::GetTraceInfo(*m_promise) : TaskTraceInfo{};
+	}
+
 	template <class Type>
 	inline bool Task<Type>::await_ready() const noexcept
 	{
@@ -130,146 +629,91 @@ namespace cra
 	}
 
 	template <class Type>
-	class Task<Type>::promise_type
+	class Task<Type>::promise_type : public detail::PromiseBase
 	{
 	public:
 		Task get_return_object()
 		{
-			return Task{ Handle::from_promise(*this), m_result.get_future() };
-		}
-		std::suspend_always initial_suspend() noexcept
-		{
-			return std::suspend_always{};
-		}
-		std::suspend_always final_suspend() noexcept
-		{
-			return std::suspend_always{};
+			handle = std::coroutine_handle<promise_type>::from_promise(*this);
+			return Task{ this };
 		}
 		void return_value(Type value)
 		{
-			this->m_result.set_value(std::forward<Type>(value));
-		}
-		void unhandled_exception()
-		{
-			throw;
-		}
-
-		template <class Rep, class Period>
-		std::suspend_always await_transform(const std::chrono::duration<Rep, Period>& relTime)
-		{
-			if (relTime.count() > 0) {
-				detail::TaskQueueImpl::SleepFor(Handle::from_promise(*this), relTime);
-			}
-			return std::suspend_always{};
+			m_result.set_value(std::forward<Type>(value));
 		}
-		std::suspend_always await_transform(std::uint32_t relTime)
+		void unhandled_exception() noexcept
 		{
-			return await_transform(std::chrono::milliseconds{ relTime });
+			m_result.set_exception(std::current_exception());
 		}
-		template <class U>
-		decltype(auto) await_transform(Task<U>& task)
+		detail::TaskResult<Type>& result() noexcept
 		{
-			detail::TaskQueueImpl::Wait(Handle::from_promise(*this), task.m_coro);
-		# ifdef __GNUC__
-
-			// GCC のバグ対策
-			return detail::AwaiterWrapper<Task<U>&>{ task };
-
-		# else
-
-			return task;
-
-		# endif
-		}
-		template <class U>
-		decltype(auto) await_transform(Task<U>&& task)
-		{
-			detail::TaskQueueImpl::Wait(Handle::from_promise(*this), task.m_coro);
-		# ifdef __GNUC__
-
-			// GCC のバグ対策
-			return detail::AwaiterWrapper<Task<U>&&>{ std::move(task) };
-
-		# else
-
-			return std::move(task);
-
-		# endif
+			return m_result;
 		}
 
 	private:
-		std::promise<Type> m_result;
+		detail::TaskResult<Type> m_result;
 	};
 
 	template <>
-	class Task<void>::promise_type
+	class Task<void>::promise_type : public detail::PromiseBase
 	{
 	public:
 		Task<void> get_return_object()
 		{
-			return Task{ Handle::from_promise(*this), m_result.get_future() };
-		}
-		std::suspend_always initial_suspend() noexcept
-		{
-			return std::suspend_always{};
-		}
-		std::suspend_always final_suspend() noexcept
-		{
-			return std::suspend_always{};
+			handle = std::coroutine_handle<promise_type>::from_promise(*this);
+			return Task{ this };
 		}
-		void return_void()
+		void return_void() noexcept
 		{
 			m_result.set_value();
 		}
-		void unhandled_exception()
-		{
-			throw;
-		}
-
-		template <class Rep, class Period>
-		std::suspend_always await_transform(const std::chrono::duration<Rep, Period>& relTime)
+		void unhandled_exception() noexcept
 		{
-			if (relTime.count() > 0) {
-				detail::TaskQueueImpl::SleepFor(Handle::from_promise(*this), relTime);
-			}
-			return std::suspend_always{};
+			m_result.set_exception(std::current_exception());
 		}
-		std::suspend_always await_transform(std::uint32_t relTime)
+		detail::TaskResult<void>& result() noexcept
 		{
-			return await_transform(std::chrono::milliseconds{ relTime });
+			return m_result;
 		}
-		template <class U>
-		decltype(auto) await_transform(Task<U>& task)
-		{
-			detail::TaskQueueImpl::Wait(Handle::from_promise(*this), task.m_coro);
-		# ifdef __GNUC__
 
-			// GCC のバグ対策
-			return detail::AwaiterWrapper<Task<U>&>{ task };
-
-		# else
+	private:
+		detail::TaskResult<void> m_result;
+	};
 
-			return task;
+	inline detail::SetPriorityAwaiter SetPriority(TaskPriority priority) noexcept
+	{
+		return detail::SetPriorityAwaiter{ priority };
+	}
 
-		# endif
-		}
-		template <class U>
-		decltype(auto) await_transform(Task<U>&& task)
-		{
-			detail::TaskQueueImpl::Wait(Handle::from_promise(*this), task.m_coro);
-		# ifdef __GNUC__
+	inline detail::SetCancellationTokenAwaiter SetCancellationToken(CancellationToken token) noexcept
+	{
+		return detail::SetCancellationTokenAwaiter{ std::move(token) };
+	}
 
-			// GCC のバグ対策
-			return detail::AwaiterWrapper<Task<U>&&>{ std::move(task) };
+	inline detail::SetNameAwaiter SetName(const char* name) noexcept
+	{
+		return detail::SetNameAwaiter{ name };
+	}
 
-		# else
+	inline detail::NextFrameAwaiter NextFrame(FramePhase phase) noexcept
+	{
+		return detail::NextFrameAwaiter{ 1, phase };
+	}
 
-			return std::move(task);
+	inline detail::NextFrameAwaiter Frames(std::uint32_t count, FramePhase phase) noexcept
+	{
+		return detail::NextFrameAwaiter{ count, phase };
+	}
 
-		# endif
+	template <class Type>
+	inline void Spawn(Task<Type> task) noexcept
+	{
+		if (auto* promise = std::exchange(task.m_promise, nullptr))
+		{
+			if (detail::TaskQueueImpl::Detach(*promise))
+			{
+				promise->handle.destroy();
+			}
 		}
-
-	private:
-		std::promise<void> m_result;
-	};
+	}
 }
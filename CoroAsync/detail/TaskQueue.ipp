@@ -4,6 +4,575 @@ namespace cra
 {
 	namespace detail
 	{
+		// コルーチンフレームの末尾に置かれる解放情報
+		struct FrameTrailer
+		{
+			void (*deallocate)(void* context, void* frame, std::size_t size) noexcept;
+			void* context;
+		};
+
+		// フレーム本体のサイズから、末尾の FrameTrailer の位置を求める
+		constexpr std::size_t FrameTrailerOffset(std::size_t frameSize) noexcept
+		{
+			return (frameSize + alignof(FrameTrailer) - 1) / alignof(FrameTrailer) * alignof(FrameTrailer);
+		}
+
+		inline FrameTrailer& GetFrameTrailer(void* frame, std::size_t frameSize) noexcept
+		{
+			return *std::launder(reinterpret_cast<FrameTrailer*>(static_cast<std::byte*>(frame) + FrameTrailerOffset(frameSize)));
+		}
+
+		// サイズクラスごとの空きリストを持つコルーチンフレーム用のメモリプール
+		// 終了時に確保済みのフレームが解放されることもあるため、デストラクタでは何もしない
+		class FramePool
+		{
+		public:
+			// この粒度でブロックのサイズを切り上げる
+			static constexpr std::size_t Granularity = 64;
+
+			// プールで扱う最大のブロックサイズ。これを超えるものは operator new で直接確保する
+			static constexpr std::size_t MaxBlockSize = 2048;
+
+			void* allocate(std::size_t size)
+			{
+				++m_stats.allocations;
+				++m_stats.liveFrames;
+				if (size > MaxBlockSize)
+				{
+					++m_stats.poolMisses;
+					return ::operator new(size);
+				}
+				const auto index = SizeClassIndex(size);
+				if (auto block = m_freeLists[index])
+				{
+					++m_stats.poolHits;
+					m_freeLists[index] = block->next;
+					m_stats.pooledBytes -= BlockSize(index);
+					return block;
+				}
+				++m_stats.poolMisses;
+				return ::operator new(BlockSize(index));
+			}
+
+			void deallocate(void* p, std::size_t size) noexcept
+			{
+				--m_stats.liveFrames;
+				if (size > MaxBlockSize)
+				{
+					::operator delete(p);
+					return;
+				}
+				const auto index = SizeClassIndex(size);
+				m_freeLists[index] = ::new (p) FreeBlock{ m_freeLists[index] };
+				m_stats.pooledBytes += BlockSize(index);
+			}
+
+			// 外部のアロケータで確保されたフレームを統計に反映する
+			void countExternalAllocation() noexcept
+			{
+				++m_stats.allocations;
+				++m_stats.liveFrames;
+			}
+			void countExternalDeallocation() noexcept
+			{
+				--m_stats.liveFrames;
+			}
+
+			void release() noexcept
+			{
+				for (auto&& head : m_freeLists)
+				{
+					while (head)
+					{
+						::operator delete(std::exchange(head, head->next));
+					}
+				}
+				m_stats.pooledBytes = 0;
+			}
+
+			[[nodiscard]]
+			const FrameStats& stats() const noexcept
+			{
+				return m_stats;
+			}
+
+		private:
+			struct FreeBlock
+			{
+				FreeBlock* next;
+			};
+
+			std::array<FreeBlock*, MaxBlockSize / Granularity> m_freeLists{};
+			FrameStats m_stats;
+
+			static constexpr std::size_t SizeClassIndex(std::size_t size) noexcept
+			{
+				return (size + Granularity - 1) / Granularity - 1;
+			}
+			static constexpr std::size_t BlockSize(std::size_t index) noexcept
+			{
+				return (index + 1) * Granularity;
+			}
+		};
+
+		// スリープ中のタスクを管理するためのノード
+		// Task の promise_type に埋め込まれ、自身がタイマーヒープのどこにあるかを保持する
+		struct TimerNode
+		{
+			static constexpr std::size_t NotInHeap = static_cast<std::size_t>(-1);
+
+			TaskQueue::TimePoint deadline{};
+			std::uint64_t timerSequence = 0;
+			std::size_t heapIndex = NotInHeap;
+
+			[[nodiscard]]
+			bool isTimerScheduled() const noexcept
+			{
+				return heapIndex != NotInHeap;
+			}
+		};
+
+		// TimerNode を期限の早い順に取り出す侵入型の 4 分ヒープ
+		// 期限が同じものは追加した順に取り出す
+		class TimerHeap
+		{
+		public:
+			[[nodiscard]]
+			bool empty() const noexcept
+			{
+				return m_nodes.empty();
+			}
+
+			[[nodiscard]]
+			std::size_t size() const noexcept
+			{
+				return m_nodes.size();
+			}
+
+			[[nodiscard]]
+			TimerNode& top() const noexcept
+			{
+				return *m_nodes.front();
+			}
+
+			void push(TimerNode& node, const TaskQueue::TimePoint& deadline)
+			{
+				node.deadline = deadline;
+				node.timerSequence = m_sequence++;
+				m_nodes.push_back(&node);
+				siftUp(m_nodes.size() - 1, node);
+			}
+
+			TimerNode& pop() noexcept
+			{
+				auto& node = top();
+				erase(node);
+				return node;
+			}
+
+			void erase(TimerNode& node) noexcept
+			{
+				const auto index = node.heapIndex;
+				node.heapIndex = TimerNode::NotInHeap;
+				auto* last = m_nodes.back();
+				m_nodes.pop_back();
+				if (last == &node)
+				{
+					return;
+				}
+				if (index > 0 && Less(*last, *m_nodes[Parent(index)]))
+				{
+					siftUp(index, *last);
+				}
+				else
+				{
+					siftDown(index, *last);
+				}
+			}
+
+		private:
+			static constexpr std::size_t Arity = 4;
+
+			std::vector<TimerNode*> m_nodes;
+			std::uint64_t m_sequence = 0;
+
+			static constexpr std::size_t Parent(std::size_t index) noexcept
+			{
+				return (index - 1) / Arity;
+			}
+
+			static bool Less(const TimerNode& a, const TimerNode& b) noexcept
+			{
+				return (a.deadline < b.deadline) || (a.deadline == b.deadline && a.timerSequence < b.timerSequence);
+			}
+
+			void place(std::size_t index, TimerNode& node) noexcept
+			{
+				m_nodes[index] = &node;
+				node.heapIndex = index;
+			}
+
+			// index の位置に node を置き、親より小さい間は上に移動する
+			void siftUp(std::size_t index, TimerNode& node) noexcept
+			{
+				while (index > 0)
+				{
+					const auto parent = Parent(index);
+					if (not Less(node, *m_nodes[parent]))
+					{
+						break;
+					}
+					place(index, *m_nodes[parent]);
+					index = parent;
+				}
+				place(index, node);
+			}
+
+			// index の位置に node を置き、子のうち最小のものより大きい間は下に移動する
+			void siftDown(std::size_t index, TimerNode& node) noexcept
+			{
+				const auto size = m_nodes.size();
+				while (true)
+				{
+					const auto first = index * Arity + 1;
+					if (first >= size)
+					{
+						break;
+					}
+					auto smallest = first;
+					for (auto child = first + 1; child < std::min(first + Arity, size); ++child)
+					{
+						if (Less(*m_nodes[child], *m_nodes[smallest]))
+						{
+							smallest = child;
+						}
+					}
+					if (not Less(*m_nodes[smallest], node))
+					{
+						break;
+					}
+					place(index, *m_nodes[smallest]);
+					index = smallest;
+				}
+				place(index, node);
+			}
+		};
+
+		struct TaskNode;
+		struct WaitRecord;
+		class NodeList;
+		class TaskQueueImpl;
+
+		// TaskQueueImpl 以外でタスクを実行するスケジューラのインターフェース
+		// TaskNode::scheduler が設定されたタスクの操作は、すべてこのスケジューラに委ねられる
+		class Scheduler
+		{
+		public:
+			// 実行待ちにする
+			virtual void push(TaskNode& node) = 0;
+
+			// deadline まで実行中のタスクを待機させる
+			virtual void sleepUntil(TaskNode& node, const TaskQueue::TimePoint& deadline) = 0;
+
+			// 実行中のタスクを、 records の target のタスクのうち count 個が完了するまで待機させる
+			// 待機が不要だった場合は false を返す
+			virtual bool wait(TaskNode& node, WaitRecord* records, std::size_t recordCount, std::uint32_t count) noexcept = 0;
+
+			// タスクの完了を通知する
+			virtual void complete(TaskNode& node) noexcept = 0;
+
+			// タスクを破棄する準備をする
+			// 呼び出し元がすぐにコルーチンフレームを破棄してよい場合は true を返す
+			virtual bool remove(TaskNode& node) noexcept = 0;
+
+			// Task を手放し、完了したときにコルーチンフレームを破棄させる
+			// すでに完了していて、呼び出し元がすぐにコルーチンフレームを破棄してよい場合は true を返す
+			virtual bool detach(TaskNode& node) noexcept = 0;
+
+			// タスクが完了するか、時刻が absTime になるまで呼び出し元のスレッドをブロックする
+			virtual void waitUntil(TaskNode& node, const TaskQueue::TimePoint& absTime) = 0;
+
+			// このスケジューラのタスクの完了を待っている、タスクキューのタスクの待機をやめる
+			// タスクキューのスレッドから、再開がまだ決まっていない場合に呼ばれる
+			virtual void removeWaiter(TaskNode& node) noexcept = 0;
+
+		protected:
+			~Scheduler() = default;
+		};
+
+		// 別のスレッドからタスクキューに届ける完了通知
+		// TaskQueueImpl::PostRemote で送ると、タスクキューのスレッドで deliver が呼ばれる
+		class RemoteCompletion
+		{
+		public:
+			// タスクキューのスレッドで呼ばれる
+			virtual void deliver() noexcept = 0;
+
+			RemoteCompletion* nextCompletion = nullptr;
+
+		protected:
+			~RemoteCompletion() = default;
+		};
+
+		// タスクキューのタスクが、別のスケジューラのタスクの完了を待っていることを表す
+		// 待っているタスクが再開できるようになると、スケジューラからタスクキューに完了通知として送られ、タスクキューのスレッドで実行待ちにする
+		class RemoteWait final : public RemoteCompletion
+		{
+		public:
+			RemoteWait(Scheduler& scheduler, TaskNode& waiter, TaskQueueImpl& queue) noexcept
+				: scheduler{ scheduler }, queue{ queue }, waiter{ &waiter } {}
+
+			void deliver() noexcept override;
+
+			// 待たれているタスクを管理するスケジューラと、完了通知を送るタスクキュー
+			Scheduler& scheduler;
+			TaskQueueImpl& queue;
+
+			// 待っているタスク。待機をやめると nullptr になる
+			TaskNode* waiter;
+
+			// スケジューラが再開を決めたか。 true になった後は、スケジューラは waiter のタスクに触れない
+			std::atomic<bool> woken{ false };
+		};
+
+		// タスクキューの外で待っているタスクの、待機を取り消すためのインターフェース
+		// 待機を始めるときに TaskNode::cancelableWait に設定すると、キャンセルされたときに cancelWait が呼ばれる
+		class CancelableWait
+		{
+		public:
+			// 待機しているデータ構造からタスクを外す。タスクはこの後すぐに実行待ちになる
+			virtual void cancelWait() noexcept = 0;
+
+		protected:
+			~CancelableWait() = default;
+		};
+
+		// キャンセル要求の共有状態
+		// CancellationSource 、 CancellationToken 、結びつけられたタスクが参照カウントで共有する
+		// 結びつけられたタスクは侵入型のリストで保持し、キャンセルされるとすべてにキャンセルを伝える
+		class CancellationState
+		{
+		public:
+			CancellationState() = default;
+
+			CancellationState(const CancellationState&) = delete;
+
+			CancellationState& operator =(const CancellationState&) = delete;
+
+			void addRef() noexcept
+			{
+				++m_refCount;
+			}
+
+			void release() noexcept
+			{
+				if (--m_refCount == 0)
+				{
+					delete this;
+				}
+			}
+
+			[[nodiscard]]
+			bool isCanceled() const noexcept
+			{
+				return m_canceled;
+			}
+
+			// タスクを結びつける。すでにキャンセルされていれば、タスクもキャンセルする
+			void bind(TaskNode& node);
+
+			void unbind(TaskNode& node) noexcept;
+
+			void cancel();
+
+		private:
+			std::size_t m_refCount = 1;
+			bool m_canceled = false;
+			TaskNode* m_head = nullptr;
+		};
+
+		// タスクキューが I/O の準備完了を待つためのインターフェース
+		// TaskQueueImpl::setPoller で設定すると、実行できるタスクがないときに条件変数の代わりに poll でブロックする
+		class Poller
+		{
+		public:
+			// 準備完了を待っている I/O があるか
+			virtual bool hasPending() const noexcept = 0;
+
+			// 準備ができた I/O を待っているタスクを実行待ちにする
+			// absTime まで、もしくは wake が呼ばれるまでブロックしてよい。 absTime が過去の場合はブロックしない
+			virtual void poll(const TaskQueue::TimePoint& absTime) = 0;
+
+			// poll でブロックしているスレッドを起こす。どのスレッドからでも呼び出せる
+			virtual void wake() noexcept = 0;
+
+			// タスクキューが所有し、タスクキューとともに破棄される
+			virtual ~Poller() = default;
+		};
+
+		// タスクのスケジューリング上の状態
+		enum class TaskState : std::uint8_t
+		{
+			// どのキューにも入っていない
+			Idle,
+
+			// 実行待ちキューに入っている
+			Ready,
+
+			// 実行中
+			Running,
+
+			// タイマーヒープに入っている
+			Sleeping,
+
+			// 他のタスクの完了を待っている
+			Waiting,
+
+			// フレームの区切りを待っている
+			WaitingFrame,
+
+			// 完了した
+			Done,
+		};
+
+		// あるタスクが別のタスクの完了を待っていることを表すレコード
+		// 待っている側のコルーチンフレーム（awaiter）に置かれ、待たれている側の待機リストにつながれる
+		struct WaitRecord
+		{
+			TaskNode* waiter = nullptr;
+			TaskNode* target = nullptr;
+			WaitRecord* prev = nullptr;
+			WaitRecord* next = nullptr;
+		};
+
+		// タスクキューがタスクを管理するための侵入型のノード
+		// Task の promise_type に埋め込まれ、自身がどのデータ構造に入っているかを保持する
+		struct TaskNode : TimerNode
+		{
+			TaskQueue::Handle handle = nullptr;
+			TaskState state = TaskState::Idle;
+
+			// 一度でも再開されたか
+			bool started = false;
+
+			// Task が手放され、完了したときにコルーチンフレームを破棄するか
+			// scheduler が設定されている場合は、スケジューラのロックの下で読み書きする
+			bool detached = false;
+
+			// 優先度と、タイムクォンタムを続けて超過した回数
+			TaskPriority priority = TaskPriority::Normal;
+			std::uint8_t overruns = 0;
+
+			// キャンセルされたか
+			bool canceled = false;
+
+			// 結びつけられたキャンセル要求の共有状態と、その中での前後
+			CancellationState* cancellation = nullptr;
+			TaskNode* cancellationPrev = nullptr;
+			TaskNode* cancellationNext = nullptr;
+
+			// タスクキューの外で待っている場合に、その待機を取り消す方法
+			CancelableWait* cancelableWait = nullptr;
+
+			// タスクを管理するスケジューラ。 nullptr の場合は queue のタスクキューが管理する
+			Scheduler* scheduler = nullptr;
+
+			// タスクが作成されたタスクキュー
+			TaskQueueImpl* queue = nullptr;
+
+			// scheduler が設定されていないタスクが、別のスケジューラのタスクの完了を待っている場合の待機
+			RemoteWait* remoteWait = nullptr;
+
+			// scheduler が設定されている場合に使う、スレッド間で共有される状態
+			std::atomic<bool> completed{ false };
+			std::atomic<bool> abandoned{ false };
+
+			// 入っている NodeList とその中での前後
+			NodeList* list = nullptr;
+			TaskNode* listPrev = nullptr;
+			TaskNode* listNext = nullptr;
+
+			// このタスクの完了を待っているタスクのレコード
+			WaitRecord* waitersHead = nullptr;
+			WaitRecord* waitersTail = nullptr;
+
+			// このタスクが完了を待っているタスクのレコード
+			WaitRecord* waitRecords = nullptr;
+			std::size_t waitRecordCount = 0;
+
+			// 再開までに完了を待つ必要のあるタスクの数
+			std::uint32_t waitingCount = 0;
+
+			// フレームの区切りを待っている段階と、その段階の待機リストの中での位置
+			FramePhase framePhase = FramePhase::Update;
+			std::size_t frameIndex = 0;
+
+			// 再開する、待っている段階の何回目の再開処理か
+			std::uint64_t frameTarget = 0;
+
+# if defined(CRA_ENABLE_TRACING)
+			// トレース用の情報
+			TaskTrace trace;
+# endif
+		};
+
+		// TaskNode の侵入型の双方向リスト
+		class NodeList
+		{
+		public:
+			[[nodiscard]]
+			bool empty() const noexcept
+			{
+				return m_size == 0;
+			}
+
+			[[nodiscard]]
+			std::size_t size() const noexcept
+			{
+				return m_size;
+			}
+
+			[[nodiscard]]
+			TaskNode& front() const noexcept
+			{
+				return *m_head;
+			}
+
+			void push_back(TaskNode& node) noexcept
+			{
+				node.list = this;
+				node.listPrev = m_tail;
+				node.listNext = nullptr;
+				(m_tail ? m_tail->listNext : m_head) = &node;
+				m_tail = &node;
+				++m_size;
+			}
+
+			TaskNode& pop_front() noexcept
+			{
+				auto& node = *m_head;
+				erase(node);
+				return node;
+			}
+
+			void erase(TaskNode& node) noexcept
+			{
+				(node.listPrev ? node.listPrev->listNext : m_head) = node.listNext;
+				(node.listNext ? node.listNext->listPrev : m_tail) = node.listPrev;
+				node.list = nullptr;
+				node.listPrev = nullptr;
+				node.listNext = nullptr;
+				--m_size;
+			}
+
+		private:
+			TaskNode* m_head = nullptr;
+			TaskNode* m_tail = nullptr;
+			std::size_t m_size = 0;
+		};
+
+		// タスクキューの実装
+		// タスクの操作は、 TaskNode::scheduler が設定されていればそのスケジューラに、そうでなければ TaskNode::queue のタスクキューに委ねる
 		class TaskQueueImpl
 		{
 		public:
@@ -11,137 +580,1286 @@ namespace cra
 			using TimePoint = TaskQueue::TimePoint;
 			using Handle = TaskQueue::Handle;
 
-			// タスクキューに追加
-			static void Push(Handle h)
+			TaskQueueImpl() = default;
+
+			TaskQueueImpl(const TaskQueueImpl&) = delete;
+
+			// 残っているタスクは、どのキューにも入っていない状態にする
+			~TaskQueueImpl()
+			{
+				for (auto& tasks : m_tasks)
+				{
+					while (tasks.size())
+					{
+						tasks.pop_front().state = TaskState::Idle;
+					}
+				}
+				while (m_sleepingTasks.size())
+				{
+					static_cast<TaskNode&>(m_sleepingTasks.pop()).state = TaskState::Idle;
+				}
+				for (auto& waiters : m_frameWaiters)
+				{
+					for (auto* node : waiters)
+					{
+						if (node)
+						{
+							node->state = TaskState::Idle;
+						}
+					}
+				}
+			}
+
+			TaskQueueImpl& operator =(const TaskQueueImpl&) = delete;
+
+			// 作成されたタスクを、現在のスレッドのスケジューラもしくはタスクキューに追加
+			// タスクキューの実行中のタスクから作成された場合は、その優先度とキャンセル要求を引き継ぐ
+			static void Spawn(TaskNode& node)
+			{
+				Attach(node);
+				Push(node);
+			}
+
+			// 作成されたタスクを、現在のスレッドのスケジューラもしくはタスクキューに結びつける
+			// 実行待ちキューには追加しない
+			static void Attach(TaskNode& node)
+			{
+# if defined(CRA_ENABLE_TRACING)
+				node.trace.id = TraceBuffer::NewTaskId();
+# endif
+				node.scheduler = currentScheduler;
+				if (not node.scheduler)
+				{
+					node.queue = &Current();
+					if (const auto* parent = node.queue->m_running)
+					{
+						node.priority = parent->priority;
+						if (parent->cancellation)
+						{
+							parent->cancellation->bind(node);
+						}
+					}
+				}
+			}
+
+			// 作成されたタスクを結びつけ、作成したスレッドでそのまま実行を始める状態にする
+			// 最初に中断するまでの実行は、作成したタスクの実行として扱う
+			static void AttachEager(TaskNode& node)
+			{
+				Attach(node);
+				node.state = TaskState::Running;
+				node.started = true;
+			}
+
+			// タスクキューに追加
+			static void Push(TaskNode& node)
+			{
+				if (node.scheduler)
+				{
+					node.scheduler->push(node);
+					return;
+				}
+				node.state = TaskState::Ready;
+				node.queue->m_tasks[static_cast<std::size_t>(node.priority)].push_back(node);
+				node.queue->tracePush(node);
+			}
+
+			// タスクの優先度を変更する
+			// 実行待ちのタスクは、新しい優先度の実行待ちキューの末尾に移す
+			static void SetPriority(TaskNode& node, TaskPriority priority) noexcept
+			{
+				node.priority = priority;
+				node.overruns = 0;
+				if (not node.scheduler && node.state == TaskState::Ready)
+				{
+					node.list->erase(node);
+					node.queue->m_tasks[static_cast<std::size_t>(priority)].push_back(node);
+				}
+			}
+
+			// タスクのトレース用の名前を設定する
+			static void SetName([[maybe_unused]] TaskNode& node, [[maybe_unused]] const char* name) noexcept
+			{
+# if defined(CRA_ENABLE_TRACING)
+				node.trace.name = name;
+# endif
+			}
+
+			// タスクのトレース情報を返す
+			[[nodiscard]]
+			static TaskTraceInfo GetTraceInfo([[maybe_unused]] const TaskNode& node) noexcept
+			{
+				TaskTraceInfo info;
+# if defined(CRA_ENABLE_TRACING)
+				info.id = node.trace.id;
+				info.name = node.trace.name;
+				info.resumes = node.trace.resumes;
+				info.runTime = node.trace.runTime;
+				info.timerSlip = node.trace.timerSlip;
+# endif
+				return info;
+			}
+
+			// 実行中のタスクのスリープ時間を設定
+			template <class Rep, class Period>
+			static void SleepFor(TaskNode& node, const std::chrono::duration<Rep, Period>& relTime)
+			{
+				const auto now = Now(node);
+				SleepUntil(node, now + std::chrono::ceil<Clock::duration>(relTime), now);
+			}
+
+			// 実行中のタスクを、時刻が deadline になるまでスリープさせる
+			// now は Now(node) で得た現在時刻
+			static void SleepUntil(TaskNode& node, const TimePoint& deadline, [[maybe_unused]] const TimePoint& now)
+			{
+				if (node.scheduler)
+				{
+					node.scheduler->sleepUntil(node, deadline);
+					return;
+				}
+				node.queue->m_sleepingTasks.push(node, node.queue->coalesceDeadline(deadline));
+				node.state = TaskState::Sleeping;
+				node.queue->traceEvent(TraceEventType::Sleep, node, deadline - now);
+			}
+
+			// 実行中のタスクを、 phase の段階の再開処理が count 回行われるまで待機させる
+			// スケジューラのタスクはフレームを扱わないので、そのまま実行待ちにする
+			static void WaitFrames(TaskNode& node, std::uint32_t count, FramePhase phase)
+			{
+				if (node.scheduler)
+				{
+					Push(node);
+					return;
+				}
+				auto& queue = *node.queue;
+				const auto index = static_cast<std::size_t>(phase);
+				auto& waiters = queue.m_frameWaiters[index];
+				waiters.push_back(&node);
+				node.framePhase = phase;
+				node.frameIndex = (waiters.size() - 1);
+				node.frameTarget = (queue.m_frameSweeps[index] + count);
+				node.state = TaskState::WaitingFrame;
+			}
+
+			// フレームの区切りを待っているタスクを待機リストから外す
+			// 待機リストの要素は nullptr にしておき、次の再開処理で詰める
+			static void EraseFrameWaiter(TaskNode& node) noexcept
+			{
+				node.queue->m_frameWaiters[static_cast<std::size_t>(node.framePhase)][node.frameIndex] = nullptr;
+			}
+
+			// タスクのスリープの終了時刻の基準になる現在時刻
+			// タスクキューのタスクはタスクキューの現在時刻、スケジューラのタスクは Clock::now()
+			[[nodiscard]]
+			static TimePoint Now(const TaskNode& node) noexcept
+			{
+				return node.scheduler ? Clock::now() : node.queue->now();
+			}
+
+			// 実行中のタスクを、 records の target のタスクのうち count 個が完了するまで待機させる
+			// 次に実行するタスクのハンドルを返す
+			static Handle Wait(TaskNode& node, WaitRecord* records, std::size_t recordCount, std::uint32_t count) noexcept
+			{
+				if (auto scheduler = FindScheduler(node, records, recordCount))
+				{
+					// 待機が不要だった場合は、そのまま再開する
+					return scheduler->wait(node, records, recordCount, count) ? Handle{ std::noop_coroutine() } : node.handle;
+				}
+				node.state = TaskState::Waiting;
+				node.waitRecords = records;
+				node.waitRecordCount = recordCount;
+				node.waitingCount = count;
+				node.queue->traceEvent(TraceEventType::Wait, node);
+				for (std::size_t i = 0; i < recordCount; ++i)
+				{
+					LinkWaitRecord(node, records[i]);
+				}
+				// ContinuationMode::Eager で待たれるタスクが同じタスクキューで未開始の場合は、その場で開始する
+				if (recordCount == 1 && node.queue->m_continuationMode == ContinuationMode::Eager)
+				{
+					auto& target = *records[0].target;
+					if (target.state == TaskState::Ready && not target.started && target.queue == node.queue)
+					{
+						target.list->erase(target);
+						return Start(target);
+					}
+				}
+				return std::noop_coroutine();
+			}
+
+			// タスクの完了を通知し、完了を待っているタスクを再開させる
+			// 次に実行するタスクのハンドルを返す
+			static Handle Complete(TaskNode& node) noexcept
+			{
+				if (node.scheduler)
+				{
+					node.scheduler->complete(node);
+					return std::noop_coroutine();
+				}
+				node.state = TaskState::Done;
+				node.queue->traceEvent(TraceEventType::Complete, node);
+				if (node.cancellation)
+				{
+					node.cancellation->unbind(node);
+				}
+				TaskNode* next = nullptr;
+				while (auto record = node.waitersHead)
+				{
+					auto& waiter = *record->waiter;
+					UnlinkWaitRecord(*record);
+					if (--waiter.waitingCount == 0)
+					{
+						UnlinkWaitRecords(waiter);
+						// ContinuationMode::Eager では、同じタスクキューで最初に再開できるようになったタスクをその場で再開する
+						if (node.queue->m_continuationMode == ContinuationMode::Eager && not next && not waiter.scheduler && waiter.queue == node.queue)
+						{
+							next = &waiter;
+						}
+						else
+						{
+							Push(waiter);
+						}
+					}
+				}
+				return next ? Start(*next) : std::noop_coroutine();
+			}
+
+			// タスクキューから削除
+			// Task のデストラクタやムーブ代入演算子から呼ばれるので noexcept に実装
+			// 呼び出し元がすぐにコルーチンフレームを破棄してよい場合は true を返す
+			static bool Remove(TaskNode& node) noexcept
+			{
+				// キャンセル要求との結びつきは、タスクを作成したスレッドで管理している
+				if (node.cancellation)
+				{
+					node.cancellation->unbind(node);
+				}
+				if (node.scheduler)
+				{
+					return node.scheduler->remove(node);
+				}
+				if (node.queue && node.queue->m_running == &node)
+				{
+					node.queue->traceStop(node);
+					node.queue->m_running = nullptr;
+				}
+				switch (node.state)
+				{
+				case TaskState::Ready:
+					node.list->erase(node);
+					break;
+				case TaskState::Sleeping:
+					node.queue->m_sleepingTasks.erase(node);
+					break;
+				case TaskState::Waiting:
+					if (node.remoteWait)
+					{
+						RemoveRemoteWait(node);
+					}
+					else
+					{
+						UnlinkWaitRecords(node);
+					}
+					break;
+				case TaskState::WaitingFrame:
+					EraseFrameWaiter(node);
+					break;
+				default:
+					// 完了している場合などは、削除の必要なし
+					break;
+				}
+				// このタスクを待っているタスクとのつながりを切る
+				while (node.waitersHead)
+				{
+					UnlinkWaitRecord(*node.waitersHead);
+				}
+				if (node.state != TaskState::Done)
+				{
+					node.state = TaskState::Idle;
+				}
+				return true;
+			}
+
+			// Task を手放し、完了したときにコルーチンフレームを破棄させる
+			// すでに完了していて、呼び出し元がすぐにコルーチンフレームを破棄してよい場合は true を返す
+			static bool Detach(TaskNode& node) noexcept
+			{
+				if (node.scheduler)
+				{
+					return node.scheduler->detach(node);
+				}
+				if (node.state == TaskState::Done)
+				{
+					return Remove(node);
+				}
+				node.detached = true;
+				return false;
+			}
+
+			// 別のスケジューラのタスクの完了を待っているタスクの待機をやめる
+			// 再開が決まっている場合は、届く完了通知を無視させる
+			static void RemoveRemoteWait(TaskNode& node) noexcept
+			{
+				auto& wait = *node.remoteWait;
+				if (wait.woken.load(std::memory_order_acquire))
+				{
+					node.remoteWait = nullptr;
+					wait.waiter = nullptr;
+					return;
+				}
+				wait.scheduler.removeWaiter(node);
+			}
+
+			// 実行中の状態にして、ハンドルを返す
+			static Handle Start(TaskNode& node) noexcept
+			{
+				node.state = TaskState::Running;
+				node.started = true;
+				node.cancelableWait = nullptr;
+				if (not node.scheduler)
+				{
+					node.queue->traceStart(node);
+					node.queue->m_running = &node;
+				}
+				return node.handle;
+			}
+
+			// タスクをキャンセルする
+			// スリープ中や待機中のタスクはすぐに実行待ちにし、完了を待っているタスクにもキャンセルを伝える
+			// スレッドプールなどで実行中のタスクはキャンセルできない
+			static void Cancel(TaskNode& node)
+			{
+				if (node.canceled || node.scheduler || node.state == TaskState::Done)
+				{
+					return;
+				}
+				node.canceled = true;
+				switch (node.state)
+				{
+				case TaskState::Sleeping:
+					node.queue->m_sleepingTasks.erase(node);
+					Push(node);
+					break;
+				case TaskState::WaitingFrame:
+					EraseFrameWaiter(node);
+					Push(node);
+					break;
+				case TaskState::Waiting:
+					// 別のスケジューラのタスクは、キャンセルせずに待機だけをやめる
+					if (node.remoteWait)
+					{
+						RemoveRemoteWait(node);
+						Push(node);
+					}
+					else if (node.waitRecordCount)
+					{
+						for (std::size_t i = 0; i < node.waitRecordCount; ++i)
+						{
+							if (auto* target = node.waitRecords[i].target)
+							{
+								Cancel(*target);
+							}
+						}
+						UnlinkWaitRecords(node);
+						Push(node);
+					}
+					else if (auto* wait = std::exchange(node.cancelableWait, nullptr))
+					{
+						wait->cancelWait();
+						Push(node);
+					}
+					// 取り消せない待機の場合は、再開したときにキャンセルを伝える
+					break;
+				default:
+					// 実行待ちや実行中の場合は、次の co_await でキャンセルを伝える
+					break;
+				}
+			}
+
+			// タスクにキャンセル要求の共有状態を結びつける。 nullptr の場合は結びつきを解除する
+			static void SetCancellation(TaskNode& node, CancellationState* state)
+			{
+				if (node.cancellation == state || node.scheduler || node.state == TaskState::Done)
+				{
+					return;
+				}
+				if (node.cancellation)
+				{
+					node.cancellation->unbind(node);
+				}
+				if (state)
+				{
+					state->bind(node);
+				}
+			}
+
+			// タスクが完了しているか
+			[[nodiscard]]
+			static bool IsDone(const TaskNode& node) noexcept
+			{
+				return node.scheduler ? node.completed.load(std::memory_order_acquire) : (node.state == TaskState::Done);
+			}
+
+			// target で示されるタスクが完了する、もしくは時刻が absTime になるまでタスクキューを回す
+			// target が別のスケジューラに移った場合も終了する
+			// 回している間は、このタスクキューを現在のタスクキューにする
+			// 優先度の高い実行待ちキューから順に実行する
+			// 時刻の確認は、その時点で実行待ちだったタスクを最大で m_clockCheckInterval 個実行するごとに行う
+			template <class Clock, class Duration>
+			void runUntil(const TaskNode* target, const std::chrono::time_point<Clock, Duration>& absTime)
+			{
+				const CurrentScope scope{ *this };
+				// タスクの中で別のタスクの完了を待つ場合は入れ子になるので、実行中のタスクを戻せるようにする
+				auto* const running = m_running;
+				auto now = checkForResumeFromSleep(absTime);
+				auto batch = batchSize();
+				while (auto* tasks = readyTasks())
+				{
+					if (target && IsDone(*target))
+					{
+						break;
+					}
+					Start(tasks->pop_front()).resume();
+					// 対称転送で切り替わった場合は、最後に実行されたタスクに経過時間を計上する
+					// まとめて実行する場合は、タスクごとの実行時間が分からないので計上しない
+					if (m_running && m_timeQuantum > TaskQueueImpl::Clock::duration::zero() && m_clockCheckInterval <= 1)
+					{
+						chargeQuantum(*m_running, this->now() - now);
+					}
+					if (m_running)
+					{
+						traceStop(*m_running);
+					}
+					m_running = nullptr;
+					if (target && (target->scheduler || IsDone(*target)))
+					{
+						break;
+					}
+					if (--batch)
+					{
+						continue;
+					}
+					now = checkForResumeFromSleep(absTime);
+					if (now >= absTime)
+					{
+						break;
+					}
+					batch = batchSize();
+				}
+				m_running = running;
+				// 入れ子で実行していた間の時間は、待っていたタスクには計上しない
+				if (m_running)
+				{
+					traceResume(*m_running);
+				}
+			}
+
+			// フレームを1つ進め、フレームの区切りを待っているタスクを段階の順に再開する
+			void advanceFrame()
+			{
+				const CurrentScope scope{ *this };
+				auto* const running = m_running;
+				++m_frameCount;
+				for (std::size_t phase = 0; phase < FramePhaseCount; ++phase)
+				{
+					resumeFrameWaiters(phase);
+				}
+				m_running = running;
+				if (m_running)
+				{
+					traceResume(*m_running);
+				}
+			}
+
+			// 現在のスレッドの現在のタスクキュー
+			[[nodiscard]]
+			static TaskQueueImpl& Current()
+			{
+				if (not currentQueue)
+				{
+					// スレッドの終了時に、既定のタスクキューとともにフレームプールの空きブロックも解放する
+					struct DefaultQueue
+					{
+						TaskQueue queue;
+						~DefaultQueue()
+						{
+							framePool.release();
+						}
+					};
+					thread_local DefaultQueue defaultQueue;
+					currentQueue = defaultQueue.queue.m_impl.get();
+				}
+				return *currentQueue;
+			}
+
+			// 現在のスレッドの現在のタスクキューを設定する。 nullptr の場合は既定のタスクキューに戻す
+			static void SetCurrent(TaskQueueImpl* queue) noexcept
+			{
+				currentQueue = queue;
+			}
+
+			// このタスクキューを所有する TaskQueue
+			[[nodiscard]]
+			TaskQueue& owner() const noexcept
+			{
+				return *m_owner;
+			}
+
+			// コルーチンフレームをフレームプールから確保
+			static void* AllocateFrame(std::size_t size)
+			{
+				const auto totalSize = FrameTrailerOffset(size) + sizeof(FrameTrailer);
+				void* frame = framePool.allocate(totalSize);
+				::new (static_cast<std::byte*>(frame) + FrameTrailerOffset(size)) FrameTrailer{ &DeallocateFrame, nullptr };
+				return frame;
+			}
+
+			// 現在のスレッドのフレームプール
+			static FramePool& GetFramePool() noexcept
+			{
+				return framePool;
+			}
+
+			// record.target のタスクの待機リストの末尾に、 node のレコードをつなぐ
+			static void LinkWaitRecord(TaskNode& node, WaitRecord& record) noexcept
+			{
+				auto& target = *record.target;
+				record.waiter = &node;
+				record.prev = target.waitersTail;
+				record.next = nullptr;
+				(target.waitersTail ? target.waitersTail->next : target.waitersHead) = &record;
+				target.waitersTail = &record;
+			}
+
+			static void UnlinkWaitRecord(WaitRecord& record) noexcept
+			{
+				auto& target = *record.target;
+				(record.prev ? record.prev->next : target.waitersHead) = record.next;
+				(record.next ? record.next->prev : target.waitersTail) = record.prev;
+				record.target = nullptr;
+				record.prev = nullptr;
+				record.next = nullptr;
+			}
+
+			// node が待っているタスクの待機リストから、 node のレコードをすべて外す
+			static void UnlinkWaitRecords(TaskNode& node) noexcept
+			{
+				for (std::size_t i = 0; i < node.waitRecordCount; ++i)
+				{
+					if (node.waitRecords[i].target)
+					{
+						UnlinkWaitRecord(node.waitRecords[i]);
+					}
+				}
+				node.waitRecords = nullptr;
+				node.waitRecordCount = 0;
+				node.waitingCount = 0;
+			}
+
+			// 別のスレッドに任せた処理の開始を記録する
+			// 完了が届くまで、 runUntil は実行できるタスクがなくても終了せずに待つ
+			void beginRemote() noexcept
 			{
-				tasks.emplace_back(h, false);
+				++m_pendingRemote;
 			}
 
-			// 実行中のタスクのスリープ時間を設定
-			template <class Rep, class Period>
-			static void SleepFor(Handle h, const std::chrono::duration<Rep, Period>& relTime)
+			// 別のスレッドから完了を通知する。どのスレッドからでも呼び出せる
+			void postRemote(RemoteCompletion& completion) noexcept
+			{
+				auto head = m_remoteHead.load(std::memory_order_relaxed);
+				do
+				{
+					completion.nextCompletion = head;
+				} while (not m_remoteHead.compare_exchange_weak(head, &completion, std::memory_order_seq_cst, std::memory_order_relaxed));
+				if (m_loopSleeping.load(std::memory_order_seq_cst))
+				{
+					if (auto reactor = m_pollerView.load(std::memory_order_seq_cst))
+					{
+						reactor->wake();
+						return;
+					}
+					std::lock_guard lock{ m_wakeMutex };
+					m_wakeCondition.notify_one();
+				}
+			}
+
+			// I/O の準備完了を待つ Poller
+			[[nodiscard]]
+			Poller* poller() const noexcept
 			{
-				asleep = true;
-				sleepingTasks.emplace(Clock::now() + relTime, h);
+				return m_poller.get();
 			}
 
-			static void Wait(Handle h, Handle taskToWait)
+			// I/O の準備完了を待つ Poller を設定する。タスクキューのスレッドから呼び出す
+			void setPoller(std::unique_ptr<Poller> poller) noexcept
 			{
-				asleep = true;
-				taskWaitingTasks.emplace(taskToWait, h);
-				++taskWaitingCount[h];
+				m_pollerView.store(poller.get(), std::memory_order_seq_cst);
+				m_poller = std::move(poller);
 			}
 
-			// タスクキューから削除
-			// Task のデストラクタやムーブ代入演算子から呼ばれるので noexcept に実装
-			static void Remove(Handle h) noexcept
+			// 現在のスレッドで作成されたタスクを管理するスケジューラ。 nullptr の場合は現在のタスクキュー
+			inline static thread_local Scheduler* currentScheduler = nullptr;
+
+		private:
+			friend class cra::TaskQueue;
+
+			// runUntil の間、現在のタスクキューを切り替える
+			class CurrentScope
 			{
-				// 完了している場合、削除の必要なし
-				if (h.done())
+			public:
+				explicit CurrentScope(TaskQueueImpl& queue) noexcept
+					: m_previous{ std::exchange(currentQueue, &queue) } {}
+				CurrentScope(const CurrentScope&) = delete;
+				~CurrentScope()
 				{
-					return;
+					currentQueue = m_previous;
+				}
+				CurrentScope& operator =(const CurrentScope&) = delete;
+
+			private:
+				TaskQueueImpl* m_previous;
+			};
+
+			// フレームプールはスレッドごとに持つ
+			inline static thread_local FramePool framePool;
+			inline static thread_local TaskQueueImpl* currentQueue = nullptr;
+
+			TaskQueue* m_owner = nullptr;
+			std::array<NodeList, TaskPriorityCount> m_tasks;
+			TimerHeap m_sleepingTasks;
+
+			// 実行中のタスク。実行中のタスクがなければ nullptr
+			TaskNode* m_running = nullptr;
+
+			// タスクを1回再開したときに超過してはならない実行時間。 0 の場合は無制限
+			Clock::duration m_timeQuantum = Clock::duration::zero();
+
+			// スリープの終了時刻を切り上げる単位。 0 の場合は切り上げない
+			Clock::duration m_timerSlack = Clock::duration::zero();
+
+			// タイムクォンタムをこの回数続けて超過したタスクは、優先度を1つ下げる
+			static constexpr std::uint8_t DemotionThreshold = 3;
+
+			// 時刻を確認するまでに実行するタスクの最大数
+			std::uint32_t m_clockCheckInterval = 1;
+
+			// 現在時刻を得る方法
+			ClockMode m_clockMode = ClockMode::Steady;
+
+			// タスクが別のタスクを co_await したときの継続の仕方
+			ContinuationMode m_continuationMode = ContinuationMode::Queued;
+
+			// 仮想の時刻。 m_clockMode が ClockMode::Virtual の場合に使う
+			TimePoint m_virtualNow{};
+
+			// フレームの区切りを待っているタスクの、段階ごとの待機リスト
+			// 破棄やキャンセルで外されたタスクの要素は nullptr になっている
+			std::array<std::vector<TaskNode*>, FramePhaseCount> m_frameWaiters;
+
+			// 段階ごとの再開処理の回数
+			std::array<std::uint64_t, FramePhaseCount> m_frameSweeps{};
+
+			// advanceFrame を呼んだ回数
+			std::uint64_t m_frameCount = 0;
+
+# if defined(CRA_ENABLE_TRACING)
+			// スケジューリングの統計情報
+			TaskQueueStats m_stats;
+# endif
+
+			// 別のスレッドから届いた完了通知の、新しいものが先頭のスタック
+			std::atomic<RemoteCompletion*> m_remoteHead{ nullptr };
+			std::size_t m_pendingRemote = 0;
+			std::atomic<bool> m_loopSleeping{ false };
+			std::mutex m_wakeMutex;
+			std::condition_variable m_wakeCondition;
+
+			// m_pollerView は、別のスレッドから wake を呼ぶために読む
+			std::unique_ptr<Poller> m_poller;
+			std::atomic<Poller*> m_pollerView{ nullptr };
+
+			// 実行待ちのタスクがある間に、ブロックせずに I/O を確認する間隔
+			static constexpr std::uint32_t PollInterval = 64;
+			std::uint32_t m_pollCountdown = PollInterval;
+
+			// 別のスレッドで確保されたフレームも、解放したスレッドのフレームプールに戻す
+			static void DeallocateFrame(void*, void* frame, std::size_t size) noexcept
+			{
+				framePool.deallocate(frame, FrameTrailerOffset(size) + sizeof(FrameTrailer));
+			}
+
+			// 待機に関わるタスクを管理するスケジューラを探す
+			static Scheduler* FindScheduler(const TaskNode& node, const WaitRecord* records, std::size_t recordCount) noexcept
+			{
+				if (node.scheduler)
+				{
+					return node.scheduler;
+				}
+				for (std::size_t i = 0; i < recordCount; ++i)
+				{
+					if (records[i].target->scheduler)
+					{
+						return records[i].target->scheduler;
+					}
+				}
+				return nullptr;
+			}
+
+			// 実行待ちのタスクがある最も優先度の高い実行待ちキュー。なければ nullptr
+			NodeList* readyTasks() noexcept
+			{
+				for (auto& tasks : m_tasks)
+				{
+					if (tasks.size())
+					{
+						return &tasks;
+					}
 				}
-				for (auto&& e : tasks)
+				return nullptr;
+			}
+
+			// 次に時刻を確認するまでに実行するタスクの数
+			// 今の時点で実行待ちのタスクの数までにとどめ、実行中に追加されたタスクより先にスリープの終了などを確認する
+			[[nodiscard]]
+			std::size_t batchSize() const noexcept
+			{
+				if (m_clockCheckInterval <= 1)
 				{
-					if (e.first == h) e.second = true;
+					return 1;
 				}
-				for (auto&& e : sleepingTasks)
+				return std::clamp<std::size_t>(readyCount(), 1, m_clockCheckInterval);
+			}
+
+			// 実行待ちのタスクの数
+			[[nodiscard]]
+			std::size_t readyCount() const noexcept
+			{
+				std::size_t ready = 0;
+				for (const auto& tasks : m_tasks)
 				{
-					if (e.second == h) e.second = nullptr;
+					ready += tasks.size();
 				}
-				for (auto&& e : taskWaitingTasks)
+				return ready;
+			}
+
+			// トレースの記録
+			// CRA_ENABLE_TRACING が定義されていなければ、何もしない
+			// 時刻はクロックの設定によらず、実時間で記録する
+			void traceEvent([[maybe_unused]] TraceEventType type, [[maybe_unused]] const TaskNode& node,
+				[[maybe_unused]] Clock::duration duration = Clock::duration::zero(), [[maybe_unused]] std::size_t queueDepth = 0) noexcept
+			{
+# if defined(CRA_ENABLE_TRACING)
+				switch (type)
 				{
-					if (e.second == h) e.second = nullptr;
+				case TraceEventType::Sleep:
+					++m_stats.sleeps;
+					break;
+				case TraceEventType::Wait:
+					++m_stats.waits;
+					break;
+				case TraceEventType::Complete:
+					++m_stats.completions;
+					break;
+				default:
+					break;
 				}
+				TraceEvent event;
+				event.time = ((type == TraceEventType::Run) ? node.trace.runStart : Clock::now());
+				event.duration = duration;
+				event.taskId = node.trace.id;
+				event.taskName = node.trace.name;
+				event.threadId = TraceBuffer::ThreadId();
+				event.queueDepth = static_cast<std::uint32_t>(queueDepth);
+				event.type = type;
+				TraceBuffer::Instance().record(event);
+# endif
 			}
 
-			// coro で示されるタスクが完了する、もしくは時刻が absTime になるまでタスクキューを回す
-			template <class Clock, class Duration>
-			static void RunUntil(Handle coro, const std::chrono::time_point<Clock, Duration>& absTime)
+			void tracePush([[maybe_unused]] const TaskNode& node) noexcept
+			{
+# if defined(CRA_ENABLE_TRACING)
+				const auto depth = readyCount();
+				++m_stats.pushes;
+				m_stats.maxReadyTasks = std::max(m_stats.maxReadyTasks, depth);
+				traceEvent(TraceEventType::Push, node, Clock::duration::zero(), depth);
+# endif
+			}
+
+			// 実行中のタスクがあれば、その実行を打ち切ってから node の実行を始める
+			void traceStart([[maybe_unused]] TaskNode& node) noexcept
+			{
+# if defined(CRA_ENABLE_TRACING)
+				if (m_running && m_running != &node)
+				{
+					traceStop(*m_running);
+				}
+				++m_stats.resumes;
+				++node.trace.resumes;
+				node.trace.runStart = Clock::now();
+# endif
+			}
+
+			void traceResume([[maybe_unused]] TaskNode& node) noexcept
+			{
+# if defined(CRA_ENABLE_TRACING)
+				node.trace.runStart = Clock::now();
+# endif
+			}
+
+			void traceStop([[maybe_unused]] TaskNode& node) noexcept
+			{
+# if defined(CRA_ENABLE_TRACING)
+				const auto elapsed = (Clock::now() - node.trace.runStart);
+				node.trace.runTime += elapsed;
+				m_stats.runTime += elapsed;
+				traceEvent(TraceEventType::Run, node, elapsed);
+# endif
+			}
+
+			void traceWake([[maybe_unused]] TaskNode& node, [[maybe_unused]] Clock::duration slip) noexcept
+			{
+# if defined(CRA_ENABLE_TRACING)
+				node.trace.timerSlip += slip;
+				m_stats.timerSlip += slip;
+				m_stats.maxTimerSlip = std::max(m_stats.maxTimerSlip, slip);
+				traceEvent(TraceEventType::Wake, node, slip);
+# endif
+			}
+
+			// phase の段階を待っているタスクのうち、再開するものを待ち始めた順に再開する
+			// 再開中に待ち始めたタスクは末尾に追加されるので、開始時点の要素だけをたどり、残すタスクと合わせて先頭に詰める
+			void resumeFrameWaiters(std::size_t phase)
 			{
-				CheckForResumeFromSleep(absTime);
-				while (tasks.size() && not (coro && coro.done()))
+				auto& waiters = m_frameWaiters[phase];
+				const auto sweep = ++m_frameSweeps[phase];
+				const auto count = waiters.size();
+				std::size_t kept = 0;
+				for (std::size_t i = 0; i < count; ++i)
 				{
-					auto [handle, removed] = tasks.front();
-					tasks.pop_front();
-					if (removed)
+					auto* node = waiters[i];
+					if (not node)
 					{
-						auto [first, last] = taskWaitingTasks.equal_range(handle);
-						taskWaitingTasks.erase(first, last);
-						taskWaitingCount.erase(handle);
 						continue;
 					}
-					asleep = false;
-					handle.resume();
-					if (handle.done())
+					if (sweep < node->frameTarget)
 					{
-						auto [first, last] = taskWaitingTasks.equal_range(handle);
-						for (auto it = first; it != last; ++it)
-						{
-							--taskWaitingCount[it->second];
-							if (it->second && taskWaitingCount[it->second] == 0)
-							{
-								tasks.emplace_back(it->second, false);
-							}
-						}
-						taskWaitingTasks.erase(first, last);
+						node->frameIndex = kept;
+						waiters[kept++] = node;
+						continue;
 					}
-					else if (not asleep)
+					waiters[i] = nullptr;
+					Start(*node).resume();
+					if (m_running)
 					{
-						tasks.emplace_back(handle, false);
+						traceStop(*m_running);
 					}
-					CheckForResumeFromSleep(absTime);
-					if (Clock::now() >= absTime)
+					m_running = nullptr;
+				}
+				for (std::size_t i = count; i < waiters.size(); ++i)
+				{
+					if (auto* node = waiters[i])
 					{
-						break;
+						node->frameIndex = kept;
+						waiters[kept++] = node;
 					}
 				}
+				waiters.resize(kept);
 			}
 
-		private:
-			inline static std::deque<std::pair<Handle, bool>> tasks;
-			inline static std::multimap<TimePoint, Handle> sleepingTasks;
-			inline static std::multimap<Handle, Handle> taskWaitingTasks;
-			inline static std::map<Handle, std::uint32_t> taskWaitingCount;
-			inline static bool asleep = false;
+			// タイマースラックが設定されていれば、スリープの終了時刻をその倍数の時刻に切り上げる
+			[[nodiscard]]
+			TimePoint coalesceDeadline(const TimePoint& deadline) const noexcept
+			{
+				if (m_timerSlack <= Clock::duration::zero())
+				{
+					return deadline;
+				}
+				auto remainder = (deadline.time_since_epoch() % m_timerSlack);
+				if (remainder < Clock::duration::zero())
+				{
+					remainder += m_timerSlack;
+				}
+				return (remainder == Clock::duration::zero()) ? deadline : (deadline + (m_timerSlack - remainder));
+			}
 
-			// スリープの終了のチェック
-			static void CheckForResumeFromSleep(const TimePoint& limit)
+			// タスクキューで使う現在時刻
+			// ClockMode::Coarse の場合は、 Linux では CLOCK_MONOTONIC_COARSE を読む
+			// steady_clock と同じく CLOCK_MONOTONIC を基準にするので、そのまま比べられる
+			[[nodiscard]]
+			TimePoint now() const noexcept
+			{
+				if (m_clockMode == ClockMode::Virtual)
+				{
+					return m_virtualNow;
+				}
+# if defined(__linux__)
+				if (m_clockMode == ClockMode::Coarse)
+				{
+					timespec ts;
+					::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+					return TimePoint{ std::chrono::duration_cast<Clock::duration>(std::chrono::seconds{ ts.tv_sec } + std::chrono::nanoseconds{ ts.tv_nsec }) };
+				}
+# endif
+				return Clock::now();
+			}
+
+			// タスクを1回再開したときの実行時間を計上し、タイムクォンタムを続けて超過していれば優先度を下げる
+			void chargeQuantum(TaskNode& node, Clock::duration elapsed) noexcept
+			{
+				if (elapsed <= m_timeQuantum)
+				{
+					node.overruns = 0;
+					return;
+				}
+				if (++node.overruns >= DemotionThreshold)
+				{
+					node.overruns = 0;
+					if (node.priority != TaskPriority::Low)
+					{
+						node.priority = static_cast<TaskPriority>(static_cast<std::size_t>(node.priority) + 1);
+					}
+				}
+			}
+
+			// 届いた完了通知を、届いた順に処理する
+			void deliverRemote() noexcept
+			{
+				if (not m_remoteHead.load(std::memory_order_relaxed))
+				{
+					return;
+				}
+				RemoteCompletion* head = m_remoteHead.exchange(nullptr, std::memory_order_acquire);
+				RemoteCompletion* reversed = nullptr;
+				while (head)
+				{
+					auto next = head->nextCompletion;
+					head->nextCompletion = reversed;
+					reversed = head;
+					head = next;
+				}
+				while (reversed)
+				{
+					// deliver で completion が破棄されることがあるので、先に次を読んでおく
+					auto& completion = *reversed;
+					reversed = completion.nextCompletion;
+					--m_pendingRemote;
+					completion.deliver();
+				}
+			}
+
+			// 完了通知が届くか、時刻が absTime になるまでスレッドをブロックする
+			void waitForRemote(const TimePoint& absTime)
+			{
+				std::unique_lock lock{ m_wakeMutex };
+				m_loopSleeping.store(true, std::memory_order_seq_cst);
+				const auto posted = [this] { return m_remoteHead.load(std::memory_order_seq_cst) != nullptr; };
+				if (absTime == TimePoint::max())
+				{
+					m_wakeCondition.wait(lock, posted);
+				}
+				else
+				{
+					m_wakeCondition.wait_until(lock, absTime, posted);
+				}
+				m_loopSleeping.store(false, std::memory_order_relaxed);
+			}
+
+			// Poller で I/O の準備完了か完了通知を待つ
+			void pollUntil(const TimePoint& absTime)
+			{
+				m_loopSleeping.store(true, std::memory_order_seq_cst);
+				// 完了通知がすでに届いている場合はブロックしない
+				m_poller->poll(m_remoteHead.load(std::memory_order_seq_cst) ? TimePoint::min() : absTime);
+				m_loopSleeping.store(false, std::memory_order_relaxed);
+			}
+
+			// 仮想の時刻で、実行できるタスクがないときに until まで待つ
+			// スリープの終了を待つ場合は、 I/O の準備完了と完了通知をブロックせずに確認し、何もなければ時刻を until まで進める
+			// それ以外は、残りの仮想の時間だけ実時間で待ち、時間切れになれば時刻を until まで進める
+			void waitVirtual(const TimePoint& until)
 			{
-				auto now = Clock::now();
-				while (sleepingTasks.size() && not sleepingTasks.begin()->second)
+				const bool timer = (m_sleepingTasks.size() && until == m_sleepingTasks.top().deadline);
+				const auto realUntil = timer ? TimePoint::min()
+					: (until == TimePoint::max()) ? TimePoint::max() : Clock::now() + (until - m_virtualNow);
+				if (m_poller)
+				{
+					pollUntil(realUntil);
+				}
+				else
+				{
+					waitForRemote(realUntil);
+				}
+				deliverRemote();
+				if ((not readyTasks()) && (timer || (until != TimePoint::max() && Clock::now() >= realUntil)))
 				{
-					sleepingTasks.erase(sleepingTasks.begin());
+					m_virtualNow = until;
 				}
-				if (tasks.empty() && sleepingTasks.size() && limit > sleepingTasks.begin()->first)
+			}
+
+			// スリープの終了のチェック
+			// 実行できるタスクがなければ、スリープの終了、 I/O の準備完了、別のスレッドからの完了通知のいずれかを待つ
+			// 仮想の時刻では、待つものがなくなれば時刻を limit まで進める
+			// チェックした時刻を返す
+			TimePoint checkForResumeFromSleep(const TimePoint& limit)
+			{
+				deliverRemote();
+				// 実行待ちのタスクが途切れなくても、 I/O を待つタスクが飢えないようにする
+				if (m_poller && readyTasks() && m_poller->hasPending() && --m_pollCountdown == 0)
 				{
-					std::this_thread::sleep_until(sleepingTasks.begin()->first);
-					now = sleepingTasks.begin()->first;
+					m_pollCountdown = PollInterval;
+					m_poller->poll(TimePoint::min());
 				}
-				while (sleepingTasks.size() && now >= sleepingTasks.begin()->first)
+				auto now = this->now();
+				while ((not readyTasks()) && now < limit && (m_pendingRemote || (m_poller && m_poller->hasPending()) || (m_sleepingTasks.size() && limit > m_sleepingTasks.top().deadline)))
 				{
-					if (sleepingTasks.begin()->second)
+					const auto until = m_sleepingTasks.size() ? std::min(limit, m_sleepingTasks.top().deadline) : limit;
+					if (m_clockMode == ClockMode::Virtual)
+					{
+						waitVirtual(until);
+					}
+					else if (m_poller)
+					{
+						pollUntil(until);
+					}
+					else
+					{
+						waitForRemote(until);
+					}
+					deliverRemote();
+					now = this->now();
+					if (m_sleepingTasks.size() && now >= m_sleepingTasks.top().deadline)
 					{
-						tasks.emplace_back(sleepingTasks.begin()->second, false);
+						break;
 					}
-					sleepingTasks.erase(sleepingTasks.begin());
 				}
+				while (m_sleepingTasks.size() && now >= m_sleepingTasks.top().deadline)
+				{
+					auto& node = static_cast<TaskNode&>(m_sleepingTasks.pop());
+					traceWake(node, now - node.deadline);
+					Push(node);
+				}
+				if (m_clockMode == ClockMode::Virtual && (not readyTasks()) && now < limit && limit != TimePoint::max()
+					&& (not m_pendingRemote) && not (m_poller && m_poller->hasPending()))
+				{
+					m_virtualNow = now = limit;
+				}
+				return now;
 			}
 		};
+
+		inline void RemoteWait::deliver() noexcept
+		{
+			if (waiter)
+			{
+				waiter->remoteWait = nullptr;
+				TaskQueueImpl::Push(*waiter);
+			}
+			delete this;
+		}
+
+		inline void CancellationState::bind(TaskNode& node)
+		{
+			addRef();
+			node.cancellation = this;
+			node.cancellationPrev = nullptr;
+			node.cancellationNext = m_head;
+			if (m_head)
+			{
+				m_head->cancellationPrev = &node;
+			}
+			m_head = &node;
+			if (m_canceled)
+			{
+				TaskQueueImpl::Cancel(node);
+			}
+		}
+
+		inline void CancellationState::unbind(TaskNode& node) noexcept
+		{
+			(node.cancellationPrev ? node.cancellationPrev->cancellationNext : m_head) = node.cancellationNext;
+			if (node.cancellationNext)
+			{
+				node.cancellationNext->cancellationPrev = node.cancellationPrev;
+			}
+			node.cancellation = nullptr;
+			node.cancellationPrev = nullptr;
+			node.cancellationNext = nullptr;
+			release();
+		}
+
+		inline void CancellationState::cancel()
+		{
+			if (m_canceled)
+			{
+				return;
+			}
+			m_canceled = true;
+			for (auto* node = m_head; node; node = node->cancellationNext)
+			{
+				TaskQueueImpl::Cancel(*node);
+			}
+		}
 	}
 
-	namespace TaskQueue
+	inline TaskQueue::TaskQueue()
+		: m_impl{ std::make_unique<detail::TaskQueueImpl>() }
 	{
-		template <class Rep, class Period>
-		void RunFor(const std::chrono::duration<Rep, Period>& relTime)
+		m_impl->m_owner = this;
+	}
+
+	inline TaskQueue::~TaskQueue()
+	{
+		if (detail::TaskQueueImpl::currentQueue == m_impl.get())
 		{
-			RunUntil(Clock::now() + relTime);
+			detail::TaskQueueImpl::currentQueue = nullptr;
 		}
+	}
+
+	template <class Rep, class Period>
+	TaskQueue::Clock::duration TaskQueue::runFor(const std::chrono::duration<Rep, Period>& relTime)
+	{
+		const auto absTime = now() + std::chrono::ceil<Clock::duration>(relTime);
+		runUntil(absTime);
+		return std::max(absTime - now(), Clock::duration::zero());
+	}
+
+	template <class ClockType, class Duration>
+	void TaskQueue::runUntil(const std::chrono::time_point<ClockType, Duration>& absTime)
+	{
+		m_impl->runUntil(nullptr, absTime);
+	}
+
+	inline void TaskQueue::setTimeQuantum(Clock::duration quantum) noexcept
+	{
+		m_impl->m_timeQuantum = quantum;
+	}
+
+	inline TaskQueue::Clock::duration TaskQueue::getTimeQuantum() const noexcept
+	{
+		return m_impl->m_timeQuantum;
+	}
 
-		template <class Clock, class Duration>
-		void RunUntil(const std::chrono::time_point<Clock, Duration>& absTime)
+	inline void TaskQueue::setTimerSlack(Clock::duration slack) noexcept
+	{
+		m_impl->m_timerSlack = std::max(slack, Clock::duration::zero());
+	}
+
+	inline TaskQueue::Clock::duration TaskQueue::getTimerSlack() const noexcept
+	{
+		return m_impl->m_timerSlack;
+	}
+
+	inline void TaskQueue::setClockCheckInterval(std::uint32_t interval) noexcept
+	{
+		m_impl->m_clockCheckInterval = std::max<std::uint32_t>(interval, 1);
+	}
+
+	inline std::uint32_t TaskQueue::getClockCheckInterval() const noexcept
+	{
+		return m_impl->m_clockCheckInterval;
+	}
+
+	inline void TaskQueue::setClockMode(ClockMode mode) noexcept
+	{
+		if (mode == ClockMode::Virtual && m_impl->m_clockMode != ClockMode::Virtual)
 		{
-			detail::TaskQueueImpl::RunUntil(nullptr, absTime);
+			m_impl->m_virtualNow = m_impl->now();
 		}
+		m_impl->m_clockMode = mode;
+	}
+
+	inline ClockMode TaskQueue::getClockMode() const noexcept
+	{
+		return m_impl->m_clockMode;
+	}
+
+	inline void TaskQueue::setContinuationMode(ContinuationMode mode) noexcept
+	{
+		m_impl->m_continuationMode = mode;
+	}
+
+	inline ContinuationMode TaskQueue::getContinuationMode() const noexcept
+	{
+		return m_impl->m_continuationMode;
+	}
+
+	inline TaskQueue::TimePoint TaskQueue::now() const noexcept
+	{
+		return m_impl->now();
+	}
+
+	inline void TaskQueue::advanceFrame()
+	{
+		m_impl->advanceFrame();
+	}
+
+	inline std::uint64_t TaskQueue::getFrameCount() const noexcept
+	{
+		return m_impl->m_frameCount;
+	}
+
+	inline TaskQueueStats TaskQueue::getStats() const noexcept
+	{
+		TaskQueueStats stats;
+# if defined(CRA_ENABLE_TRACING)
+		stats = m_impl->m_stats;
+# endif
+		stats.readyTasks = m_impl->readyCount();
+		stats.sleepingTasks = m_impl->m_sleepingTasks.size();
+		return stats;
+	}
+
+	inline void TaskQueue::resetStats() noexcept
+	{
+# if defined(CRA_ENABLE_TRACING)
+		m_impl->m_stats = TaskQueueStats{};
+# endif
+	}
+
+	inline TaskQueue& TaskQueue::Current()
+	{
+		return detail::TaskQueueImpl::Current().owner();
+	}
+
+	inline void TaskQueue::SetCurrent(TaskQueue* queue) noexcept
+	{
+		detail::TaskQueueImpl::SetCurrent(queue ? queue->m_impl.get() : nullptr);
+	}
+
+	template <class Rep, class Period>
+	TaskQueue::Clock::duration TaskQueue::RunFor(const std::chrono::duration<Rep, Period>& relTime)
+	{
+		return Current().runFor(relTime);
+	}
+
+	template <class ClockType, class Duration>
+	void TaskQueue::RunUntil(const std::chrono::time_point<ClockType, Duration>& absTime)
+	{
+		Current().runUntil(absTime);
+	}
+
+	inline void TaskQueue::AdvanceFrame()
+	{
+		Current().advanceFrame();
+	}
+
+	inline void TaskQueue::SetContinuationMode(ContinuationMode mode)
+	{
+		Current().setContinuationMode(mode);
+	}
+
+	inline ContinuationMode TaskQueue::GetContinuationMode()
+	{
+		return Current().getContinuationMode();
+	}
+
+	inline FrameStats TaskQueue::GetFrameStats() noexcept
+	{
+		return detail::TaskQueueImpl::GetFramePool().stats();
+	}
+
+	inline void TaskQueue::ReleaseFrameMemory() noexcept
+	{
+		detail::TaskQueueImpl::GetFramePool().release();
 	}
 }
@@ -0,0 +1,810 @@
+﻿# pragma once
+
+namespace cra
+{
+	namespace detail
+	{
+		// Chase-Lev の work-stealing deque
+		// 所有者のスレッドだけが push と pop を呼び出し、他のスレッドは steal を呼び出す
+		class WorkStealingDeque
+		{
+		public:
+			explicit WorkStealingDeque(std::size_t capacity = 256)
+			{
+				m_arrays.push_back(std::make_unique<Array>(capacity));
+				m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+			}
+
+			void push(TaskNode* node)
+			{
+				const auto bottom = m_bottom.load(std::memory_order_relaxed);
+				const auto top = m_top.load(std::memory_order_acquire);
+				auto* array = m_array.load(std::memory_order_relaxed);
+				if (bottom - top > static_cast<std::int64_t>(array->capacity) - 1)
+				{
+					array = grow(array, top, bottom);
+				}
+				array->put(bottom, node);
+				std::atomic_thread_fence(std::memory_order_release);
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+
+			TaskNode* pop() noexcept
+			{
+				const auto bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+				auto* array = m_array.load(std::memory_order_relaxed);
+				m_bottom.store(bottom, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				auto top = m_top.load(std::memory_order_relaxed);
+				if (top > bottom)
+				{
+					m_bottom.store(bottom + 1, std::memory_order_relaxed);
+					return nullptr;
+				}
+				auto* node = array->get(bottom);
+				if (top == bottom)
+				{
+					// 最後の1つは steal と取り合いになる
+					if (not m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					{
+						node = nullptr;
+					}
+					m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				}
+				return node;
+			}
+
+			TaskNode* steal() noexcept
+			{
+				auto top = m_top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const auto bottom = m_bottom.load(std::memory_order_acquire);
+				if (top >= bottom)
+				{
+					return nullptr;
+				}
+				auto* array = m_array.load(std::memory_order_acquire);
+				auto* node = array->get(top);
+				if (not m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					return nullptr;
+				}
+				return node;
+			}
+
+		private:
+			struct Array
+			{
+				explicit Array(std::size_t capacity)
+					: capacity{ capacity }, slots{ std::make_unique<std::atomic<TaskNode*>[]>(capacity) } {}
+
+				std::size_t capacity;
+				std::unique_ptr<std::atomic<TaskNode*>[]> slots;
+
+				TaskNode* get(std::int64_t index) const noexcept
+				{
+					return slots[static_cast<std::size_t>(index) & (capacity - 1)].load(std::memory_order_acquire);
+				}
+				void put(std::int64_t index, TaskNode* node) noexcept
+				{
+					slots[static_cast<std::size_t>(index) & (capacity - 1)].store(node, std::memory_order_release);
+				}
+			};
+
+			alignas(64) std::atomic<std::int64_t> m_top{ 0 };
+			alignas(64) std::atomic<std::int64_t> m_bottom{ 0 };
+			std::atomic<Array*> m_array{ nullptr };
+
+			// 古い配列は steal の途中で参照されていることがあるため、破棄まで保持する
+			std::vector<std::unique_ptr<Array>> m_arrays;
+
+			Array* grow(Array* array, std::int64_t top, std::int64_t bottom)
+			{
+				auto next = std::make_unique<Array>(array->capacity * 2);
+				for (auto i = top; i < bottom; ++i)
+				{
+					next->put(i, array->get(i));
+				}
+				m_arrays.push_back(std::move(next));
+				m_array.store(m_arrays.back().get(), std::memory_order_release);
+				return m_arrays.back().get();
+			}
+		};
+
+		// ワーカーで実行する、タスクではない関数呼び出し
+		class PoolJob
+		{
+		public:
+			virtual void run() noexcept = 0;
+
+			PoolJob* nextJob = nullptr;
+
+		protected:
+			~PoolJob() = default;
+		};
+
+		// ThreadPoolExecutor の実装
+		// タスク間の待機関係とタイマーは m_mutex で保護し、実行待ちのタスクはワーカーごとの WorkStealingDeque で管理する
+		class ThreadPoolExecutorImpl final : public Scheduler
+		{
+		public:
+			using Clock = TaskQueue::Clock;
+			using TimePoint = TaskQueue::TimePoint;
+
+			explicit ThreadPoolExecutorImpl(std::size_t threadCount)
+			{
+				threadCount = std::max<std::size_t>(threadCount, 1);
+				for (std::size_t i = 0; i < threadCount; ++i)
+				{
+					m_workers.push_back(std::make_unique<Worker>());
+				}
+				for (std::size_t i = 0; i < threadCount; ++i)
+				{
+					m_workers[i]->thread = std::thread{ [this, i] { runWorker(i); } };
+				}
+				m_timerThread = std::thread{ [this] { runTimer(); } };
+			}
+
+			~ThreadPoolExecutorImpl()
+			{
+				{
+					std::lock_guard lock{ m_mutex };
+					m_stopping.store(true, std::memory_order_release);
+				}
+				m_timerCondition.notify_all();
+				m_epoch.fetch_add(1, std::memory_order_seq_cst);
+				m_epoch.notify_all();
+				for (auto&& worker : m_workers)
+				{
+					worker->thread.join();
+				}
+				m_timerThread.join();
+				// 関数呼び出しは最後まで行うので、残っているものはこのスレッドで呼び出す
+				while (auto* job = std::exchange(m_jobsHead, (m_jobsHead ? m_jobsHead->nextJob : nullptr)))
+				{
+					job->run();
+				}
+				// Task がすでに破棄されているタスクは、すべてのタスクを切り離してから破棄する
+				for (auto* node : releasePending())
+				{
+					node->handle.destroy();
+				}
+			}
+
+			[[nodiscard]]
+			std::size_t threadCount() const noexcept
+			{
+				return m_workers.size();
+			}
+
+			// 実行中のタスクをこのスケジューラに移す
+			// すでに完了を待っているタスクキューのタスクは、完了通知でタスクキューに戻して再開させる
+			void adopt(TaskNode& node)
+			{
+				{
+					std::lock_guard lock{ m_mutex };
+					for (auto* record = node.waitersHead; record; record = record->next)
+					{
+						auto& waiter = *record->waiter;
+						if (not waiter.scheduler && not waiter.remoteWait)
+						{
+							beginRemoteWait(waiter);
+						}
+					}
+					node.scheduler = this;
+				}
+				push(node);
+			}
+
+			void push(TaskNode& node) override
+			{
+				if (currentExecutor == this)
+				{
+					currentWorker->deque.push(&node);
+				}
+				else
+				{
+					std::lock_guard lock{ m_injectionMutex };
+					m_injected.push_back(&node);
+					m_injectedCount.fetch_add(1, std::memory_order_release);
+				}
+				wakeWorker();
+			}
+
+			// 関数呼び出しを実行待ちにする
+			void post(PoolJob& job) noexcept
+			{
+				{
+					std::lock_guard lock{ m_injectionMutex };
+					(m_jobsTail ? m_jobsTail->nextJob : m_jobsHead) = &job;
+					m_jobsTail = &job;
+					m_injectedCount.fetch_add(1, std::memory_order_release);
+				}
+				wakeWorker();
+			}
+
+			void sleepUntil(TaskNode& node, const TimePoint& deadline) override
+			{
+				std::lock_guard lock{ m_mutex };
+				m_timers.push(node, deadline);
+				node.state = TaskState::Sleeping;
+				if (&m_timers.top() == &node)
+				{
+					m_timerCondition.notify_one();
+				}
+			}
+
+			bool wait(TaskNode& node, WaitRecord* records, std::size_t recordCount, std::uint32_t count) noexcept override
+			{
+				std::lock_guard lock{ m_mutex };
+				// タスクキューのタスクは、タスクキューで再開させる
+				// 別のスレッドが scheduler を読んでいることがあるので、変わる場合だけ書き込む
+				const bool remote = not node.scheduler;
+				if (not remote && node.scheduler != this)
+				{
+					node.scheduler = this;
+				}
+				std::uint32_t satisfied = 0;
+				for (std::size_t i = 0; i < recordCount; ++i)
+				{
+					// レコードを作ってから今までに完了したタスクはつながない
+					if (records[i].target->completed.load(std::memory_order_relaxed))
+					{
+						records[i].target = nullptr;
+						++satisfied;
+						continue;
+					}
+					TaskQueueImpl::LinkWaitRecord(node, records[i]);
+				}
+				node.waitRecords = records;
+				node.waitRecordCount = recordCount;
+				if (satisfied >= count)
+				{
+					TaskQueueImpl::UnlinkWaitRecords(node);
+					return false;
+				}
+				node.waitingCount = count - satisfied;
+				node.state = TaskState::Waiting;
+				if (remote)
+				{
+					beginRemoteWait(node);
+				}
+				return true;
+			}
+
+			void complete(TaskNode& node) noexcept override
+			{
+				// 再開するタスクは listNext で、タスクキューに戻すタスクの待機は nextCompletion で一時的につなぐ
+				TaskNode* wokenHead = nullptr;
+				TaskNode* wokenTail = nullptr;
+				RemoteWait* remoteWoken = nullptr;
+				bool abandoned = false;
+				{
+					std::lock_guard lock{ m_mutex };
+					node.state = TaskState::Done;
+					node.completed.store(true, std::memory_order_release);
+					while (auto record = node.waitersHead)
+					{
+						auto& waiter = *record->waiter;
+						TaskQueueImpl::UnlinkWaitRecord(*record);
+						if (--waiter.waitingCount == 0)
+						{
+							TaskQueueImpl::UnlinkWaitRecords(waiter);
+							if (auto* wait = waiter.remoteWait)
+							{
+								wait->nextCompletion = std::exchange(remoteWoken, wait);
+								wait->woken.store(true, std::memory_order_release);
+								continue;
+							}
+							waiter.state = TaskState::Ready;
+							(wokenTail ? wokenTail->listNext : wokenHead) = &waiter;
+							wokenTail = &waiter;
+						}
+					}
+					abandoned = (node.abandoned.load(std::memory_order_relaxed) || node.detached);
+					if (m_blockedWaiters)
+					{
+						m_doneCondition.notify_all();
+					}
+				}
+				// 再開するタスクは、このタスクを完了させたワーカーで実行する
+				while (wokenHead)
+				{
+					auto& waiter = *std::exchange(wokenHead, wokenHead->listNext);
+					waiter.listNext = nullptr;
+					push(waiter);
+				}
+				// タスクキューのタスクは、そのタスクキューに完了通知を送って再開させる
+				while (remoteWoken)
+				{
+					auto& wait = *std::exchange(remoteWoken, static_cast<RemoteWait*>(remoteWoken->nextCompletion));
+					wait.queue.postRemote(wait);
+				}
+				// Task がすでに破棄されているか手放されている場合は、ここでコルーチンフレームを破棄する
+				if (abandoned)
+				{
+					node.handle.destroy();
+				}
+			}
+
+			bool remove(TaskNode& node) noexcept override
+			{
+				bool destroyNow = false;
+				{
+					std::lock_guard lock{ m_mutex };
+					if (node.completed.load(std::memory_order_relaxed))
+					{
+						return true;
+					}
+					while (node.waitersHead)
+					{
+						TaskQueueImpl::UnlinkWaitRecord(*node.waitersHead);
+					}
+					switch (node.state)
+					{
+					case TaskState::Waiting:
+						TaskQueueImpl::UnlinkWaitRecords(node);
+						destroyNow = true;
+						break;
+					case TaskState::Sleeping:
+						m_timers.erase(node);
+						destroyNow = true;
+						break;
+					default:
+						// 実行待ちもしくは実行中の場合は、ワーカーが次に触れたときに破棄する
+						node.abandoned.store(true, std::memory_order_release);
+						break;
+					}
+				}
+				if (destroyNow)
+				{
+					node.handle.destroy();
+				}
+				return false;
+			}
+
+			bool detach(TaskNode& node) noexcept override
+			{
+				std::lock_guard lock{ m_mutex };
+				if (node.completed.load(std::memory_order_relaxed))
+				{
+					return true;
+				}
+				node.detached = true;
+				return false;
+			}
+
+			void removeWaiter(TaskNode& node) noexcept override
+			{
+				RemoteWait* wait = nullptr;
+				{
+					std::lock_guard lock{ m_mutex };
+					wait = std::exchange(node.remoteWait, nullptr);
+					wait->waiter = nullptr;
+					// ロックを取るまでの間に再開が決まっていれば、その完了通知が届く
+					if (wait->woken.load(std::memory_order_relaxed))
+					{
+						return;
+					}
+					TaskQueueImpl::UnlinkWaitRecords(node);
+				}
+				// beginRemote の分の完了通知を送っておく
+				wait->queue.postRemote(*wait);
+			}
+
+			void waitUntil(TaskNode& node, const TimePoint& absTime) override
+			{
+				std::unique_lock lock{ m_mutex };
+				++m_blockedWaiters;
+				const auto done = [&] { return node.completed.load(std::memory_order_relaxed); };
+				if (absTime == TimePoint::max())
+				{
+					m_doneCondition.wait(lock, done);
+				}
+				else
+				{
+					m_doneCondition.wait_until(lock, absTime, done);
+				}
+				--m_blockedWaiters;
+			}
+
+		private:
+			struct Worker
+			{
+				WorkStealingDeque deque;
+				std::thread thread;
+			};
+
+			std::vector<std::unique_ptr<Worker>> m_workers;
+			std::thread m_timerThread;
+
+			// ワーカー以外のスレッドから追加されたタスクと関数呼び出し
+			std::mutex m_injectionMutex;
+			std::deque<TaskNode*> m_injected;
+			PoolJob* m_jobsHead = nullptr;
+			PoolJob* m_jobsTail = nullptr;
+			std::atomic<std::size_t> m_injectedCount{ 0 };
+
+			// タスク間の待機関係、タスクの状態、タイマーを保護する
+			std::mutex m_mutex;
+			std::condition_variable m_timerCondition;
+			std::condition_variable m_doneCondition;
+			TimerHeap m_timers;
+			std::size_t m_blockedWaiters = 0;
+
+			// 仕事が追加されるたびに増える。待機中のワーカーはこれが変わるのを待つ
+			std::atomic<std::uint64_t> m_epoch{ 0 };
+			std::atomic<std::size_t> m_idleWorkers{ 0 };
+			std::atomic<bool> m_stopping{ false };
+
+			inline static thread_local ThreadPoolExecutorImpl* currentExecutor = nullptr;
+			inline static thread_local Worker* currentWorker = nullptr;
+
+			// タスクキューのタスクの、このスケジューラのタスクの完了の待機を始める
+			// タスクキューのスレッドで、 m_mutex をロックして呼ぶ
+			void beginRemoteWait(TaskNode& waiter)
+			{
+				waiter.remoteWait = new RemoteWait{ *this, waiter, *waiter.queue };
+				waiter.queue->beginRemote();
+			}
+
+			// 停止したワーカーに残っている未完了のタスクを、どのスケジューラにも属さない状態にする
+			// 実行待ちとスリープ中のタスクから、その完了を待っているタスクをたどる。タスクキューのタスクの待機は取りやめる
+			// Task がすでに破棄されているタスクを返す
+			std::vector<TaskNode*> releasePending()
+			{
+				std::vector<TaskNode*> pending;
+				const auto collect = [&](TaskNode& node)
+				{
+					if (node.scheduler == this)
+					{
+						node.scheduler = nullptr;
+						pending.push_back(&node);
+					}
+				};
+				for (auto&& worker : m_workers)
+				{
+					while (auto* node = worker->deque.pop())
+					{
+						collect(*node);
+					}
+				}
+				for (auto* node : std::exchange(m_injected, {}))
+				{
+					collect(*node);
+				}
+				while (m_timers.size())
+				{
+					collect(static_cast<TaskNode&>(m_timers.pop()));
+				}
+				std::vector<TaskNode*> abandoned;
+				for (std::size_t i = 0; i < pending.size(); ++i)
+				{
+					auto& node = *pending[i];
+					while (auto* record = node.waitersHead)
+					{
+						auto& waiter = *record->waiter;
+						TaskQueueImpl::UnlinkWaitRecord(*record);
+						if (auto* wait = waiter.remoteWait)
+						{
+							waiter.remoteWait = nullptr;
+							wait->waiter = nullptr;
+							TaskQueueImpl::UnlinkWaitRecords(waiter);
+							wait->queue.postRemote(*wait);
+						}
+						else
+						{
+							collect(waiter);
+						}
+					}
+					TaskQueueImpl::UnlinkWaitRecords(node);
+					node.state = TaskState::Idle;
+					if (node.abandoned.load(std::memory_order_relaxed))
+					{
+						abandoned.push_back(&node);
+					}
+				}
+				return abandoned;
+			}
+
+			void wakeWorker() noexcept
+			{
+				m_epoch.fetch_add(1, std::memory_order_seq_cst);
+				if (m_idleWorkers.load(std::memory_order_seq_cst))
+				{
+					m_epoch.notify_one();
+				}
+			}
+
+			// 実行待ちの仕事を1つ実行する。なければ false を返す
+			bool runOne(std::size_t index)
+			{
+				if (auto node = m_workers[index]->deque.pop())
+				{
+					execute(*node);
+					return true;
+				}
+				if (m_injectedCount.load(std::memory_order_acquire))
+				{
+					TaskNode* node = nullptr;
+					PoolJob* job = nullptr;
+					{
+						std::lock_guard lock{ m_injectionMutex };
+						if (m_injected.size())
+						{
+							node = m_injected.front();
+							m_injected.pop_front();
+							m_injectedCount.fetch_sub(1, std::memory_order_relaxed);
+						}
+						else if (m_jobsHead)
+						{
+							job = std::exchange(m_jobsHead, m_jobsHead->nextJob);
+							if (not m_jobsHead)
+							{
+								m_jobsTail = nullptr;
+							}
+							m_injectedCount.fetch_sub(1, std::memory_order_relaxed);
+						}
+					}
+					if (node)
+					{
+						execute(*node);
+						return true;
+					}
+					if (job)
+					{
+						job->run();
+						return true;
+					}
+				}
+				for (std::size_t i = 1; i < m_workers.size(); ++i)
+				{
+					if (auto node = m_workers[(index + i) % m_workers.size()]->deque.steal())
+					{
+						execute(*node);
+						return true;
+					}
+				}
+				return false;
+			}
+
+			static void execute(TaskNode& node)
+			{
+				// Task が破棄されたタスクは、再開せずにコルーチンフレームを破棄する
+				if (node.abandoned.load(std::memory_order_acquire))
+				{
+					node.handle.destroy();
+					return;
+				}
+				node.started = true;
+				node.handle.resume();
+			}
+
+			void runWorker(std::size_t index)
+			{
+				currentExecutor = this;
+				currentWorker = m_workers[index].get();
+				TaskQueueImpl::currentScheduler = this;
+				// 停止を要求されたら、実行待ちの仕事が残っていても終了する
+				while (not m_stopping.load(std::memory_order_acquire))
+				{
+					if (runOne(index))
+					{
+						continue;
+					}
+					const auto epoch = m_epoch.load(std::memory_order_seq_cst);
+					if (runOne(index))
+					{
+						continue;
+					}
+					if (m_stopping.load(std::memory_order_acquire))
+					{
+						break;
+					}
+					m_idleWorkers.fetch_add(1, std::memory_order_seq_cst);
+					m_epoch.wait(epoch, std::memory_order_seq_cst);
+					m_idleWorkers.fetch_sub(1, std::memory_order_relaxed);
+				}
+				TaskQueueImpl::GetFramePool().release();
+			}
+
+			void runTimer()
+			{
+				std::unique_lock lock{ m_mutex };
+				while (not m_stopping.load(std::memory_order_relaxed))
+				{
+					if (m_timers.empty())
+					{
+						m_timerCondition.wait(lock);
+						continue;
+					}
+					const auto deadline = m_timers.top().deadline;
+					if (Clock::now() < deadline)
+					{
+						m_timerCondition.wait_until(lock, deadline);
+						continue;
+					}
+					auto& node = static_cast<TaskNode&>(m_timers.pop());
+					node.state = TaskState::Ready;
+					push(node);
+				}
+			}
+		};
+
+		// ThreadPoolExecutor::schedule の awaiter
+		class ScheduleAwaiter
+		{
+		public:
+			explicit ScheduleAwaiter(ThreadPoolExecutorImpl& executor) noexcept
+				: m_executor{ executor } {}
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			template <class Promise>
+			void await_suspend(std::coroutine_handle<Promise> h)
+			{
+				m_executor.adopt(h.promise());
+			}
+			void await_resume() const noexcept {}
+
+		private:
+			ThreadPoolExecutorImpl& m_executor;
+		};
+
+		// RunOnPool の関数呼び出しの状態
+		// 待っているタスクが先に破棄されても、関数呼び出しが終わって完了通知が届くまでは生き続ける
+		template <class Function>
+		class RunOnPoolState final : public PoolJob, public RemoteCompletion
+		{
+		public:
+			using Result = std::invoke_result_t<Function&>;
+
+			RunOnPoolState(Function&& function, TaskNode& waiter)
+				: m_function{ std::move(function) }, m_waiter{ &waiter }, m_queue{ waiter.queue } {}
+
+			// ワーカーで呼ばれる
+			void run() noexcept override
+			{
+				invoke();
+				m_queue->postRemote(*this);
+			}
+
+			// 関数を呼び出し、結果を格納する
+			void invoke() noexcept
+			{
+				try
+				{
+					if constexpr (std::is_void_v<Result>)
+					{
+						std::invoke(m_function);
+						m_result.set_value();
+					}
+					else
+					{
+						m_result.set_value(std::invoke(m_function));
+					}
+				}
+				catch (...)
+				{
+					m_result.set_exception(std::current_exception());
+				}
+			}
+
+			// タスクキューのスレッドで呼ばれる
+			void deliver() noexcept override
+			{
+				if (not m_waiter)
+				{
+					delete this;
+					return;
+				}
+				m_delivered = true;
+				TaskQueueImpl::Push(*m_waiter);
+			}
+
+			// 完了通知を経由せずに結果を受け取る場合に呼ぶ
+			void markDelivered() noexcept
+			{
+				m_delivered = true;
+			}
+
+			// 待っているタスクが結果を受け取らずに破棄されるときに呼ばれる
+			void abandon() noexcept
+			{
+				if (m_delivered)
+				{
+					delete this;
+					return;
+				}
+				m_waiter = nullptr;
+			}
+
+			Result get()
+			{
+				auto result = std::move(m_result);
+				delete this;
+				return result.get();
+			}
+
+		private:
+			Function m_function;
+			TaskResult<Result> m_result;
+			TaskNode* m_waiter;
+
+			// m_waiter はタスクキューのスレッドで書き換えられるので、通知先は別に持つ
+			TaskQueueImpl* m_queue;
+			bool m_delivered = false;
+		};
+
+		// RunOnPool の awaiter
+		template <class Function>
+		class RunOnPoolAwaiter
+		{
+		public:
+			RunOnPoolAwaiter(ThreadPoolExecutorImpl& executor, Function&& function)
+				: m_executor{ executor }, m_function{ std::move(function) } {}
+			RunOnPoolAwaiter(RunOnPoolAwaiter&& other) noexcept(std::is_nothrow_move_constructible_v<Function>)
+				: m_executor{ other.m_executor }, m_function{ std::move(other.m_function) }, m_state{ std::exchange(other.m_state, nullptr) } {}
+			~RunOnPoolAwaiter()
+			{
+				if (m_state)
+				{
+					m_state->abandon();
+				}
+			}
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			template <class Promise>
+			bool await_suspend(std::coroutine_handle<Promise> h)
+			{
+				TaskNode& node = h.promise();
+				m_state = new RunOnPoolState<Function>{ std::move(m_function), node };
+				// スレッドプールなど、別のスケジューラで実行中のタスクは、その場で呼び出す
+				if (node.scheduler)
+				{
+					m_state->invoke();
+					m_state->markDelivered();
+					return false;
+				}
+				// どのキューにも入れずに待たせ、完了通知でタスクキューに戻す
+				node.state = TaskState::Waiting;
+				node.queue->beginRemote();
+				m_executor.post(*m_state);
+				return true;
+			}
+			decltype(auto) await_resume()
+			{
+				return std::exchange(m_state, nullptr)->get();
+			}
+
+		private:
+			ThreadPoolExecutorImpl& m_executor;
+			Function m_function;
+			RunOnPoolState<Function>* m_state = nullptr;
+		};
+	}
+
+	inline ThreadPoolExecutor::ThreadPoolExecutor(std::size_t threadCount)
+		: m_impl{ std::make_unique<detail::ThreadPoolExecutorImpl>(threadCount) } {}
+
+	inline ThreadPoolExecutor::~ThreadPoolExecutor() = default;
+
+	inline std::size_t ThreadPoolExecutor::threadCount() const noexcept
+	{
+		return m_impl->threadCount();
+	}
+
+	inline detail::ScheduleAwaiter ThreadPoolExecutor::schedule() noexcept
+	{
+		return detail::ScheduleAwaiter{ *m_impl };
+	}
+
+	template <class Function>
+	detail::RunOnPoolAwaiter<std::decay_t<Function>> RunOnPool(ThreadPoolExecutor& pool, Function&& function)
+	{
+		return detail::RunOnPoolAwaiter<std::decay_t<Function>>{ *pool.m_impl, std::decay_t<Function>(std::forward<Function>(function)) };
+	}
+}
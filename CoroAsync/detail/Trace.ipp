@@ -0,0 +1,219 @@
+﻿# pragma once
+
+namespace cra
+{
+	namespace detail
+	{
+		// タスクごとのトレース情報
+		// CRA_ENABLE_TRACING が定義されている場合にのみ、 TaskNode に埋め込まれる
+		struct TaskTrace
+		{
+			std::uint64_t id = 0;
+			const char* name = nullptr;
+			std::uint64_t resumes = 0;
+			std::chrono::steady_clock::duration runTime{};
+			std::chrono::steady_clock::duration timerSlip{};
+
+			// 実行中の場合に、今回の再開で実行を始めた時刻
+			std::chrono::steady_clock::time_point runStart{};
+		};
+
+		// すべてのスレッドで共有される、トレースのイベントのリングバッファ
+		// 書き込みは fetch_add で位置を確保するだけのロックなしで、容量を超えると古いものから上書きする
+		// スロットごとのシーケンス番号は、書き込み中は奇数になり、読み出し側はその前後で値が変わっていないものだけを使う
+		class TraceBuffer
+		{
+		public:
+			explicit TraceBuffer(std::size_t capacity)
+				: m_slots{ std::make_unique<Slot[]>(capacity) }, m_mask{ capacity - 1 } {}
+
+			// 初めて使われるときに既定の容量で作成する
+			[[nodiscard]]
+			static TraceBuffer& Instance()
+			{
+				return *Holder();
+			}
+
+			static void Reset(std::size_t capacity)
+			{
+				Holder() = std::make_unique<TraceBuffer>(std::bit_ceil(std::max<std::size_t>(capacity, 1)));
+			}
+
+			void record(const TraceEvent& event) noexcept
+			{
+				const auto index = m_writeIndex.fetch_add(1, std::memory_order_relaxed);
+				auto& slot = m_slots[index & m_mask];
+				slot.sequence.store((index * 2 + 1), std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				slot.event = event;
+				slot.sequence.store((index * 2 + 2), std::memory_order_release);
+			}
+
+			[[nodiscard]]
+			std::vector<TraceEvent> snapshot() const
+			{
+				const auto end = m_writeIndex.load(std::memory_order_acquire);
+				const auto capacity = (m_mask + 1);
+				const auto begin = (end > capacity) ? (end - capacity) : 0;
+				std::vector<TraceEvent> events;
+				events.reserve(static_cast<std::size_t>(end - begin));
+				for (auto index = begin; index < end; ++index)
+				{
+					const auto& slot = m_slots[index & m_mask];
+					if (slot.sequence.load(std::memory_order_acquire) != (index * 2 + 2))
+					{
+						continue;
+					}
+					const auto event = slot.event;
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (slot.sequence.load(std::memory_order_relaxed) == (index * 2 + 2))
+					{
+						events.push_back(event);
+					}
+				}
+				return events;
+			}
+
+			// イベントを記録したスレッドの番号
+			[[nodiscard]]
+			static std::uint32_t ThreadId() noexcept
+			{
+				static std::atomic<std::uint32_t> nextThreadId{ 1 };
+				thread_local const auto threadId = nextThreadId.fetch_add(1, std::memory_order_relaxed);
+				return threadId;
+			}
+
+			// タスクの ID を発行する
+			[[nodiscard]]
+			static std::uint64_t NewTaskId() noexcept
+			{
+				static std::atomic<std::uint64_t> nextTaskId{ 1 };
+				return nextTaskId.fetch_add(1, std::memory_order_relaxed);
+			}
+
+		private:
+			struct Slot
+			{
+				std::atomic<std::uint64_t> sequence{ 0 };
+				TraceEvent event;
+			};
+
+			[[nodiscard]]
+			static std::unique_ptr<TraceBuffer>& Holder()
+			{
+				static std::unique_ptr<TraceBuffer> instance = std::make_unique<TraceBuffer>(Tracing::DefaultCapacity);
+				return instance;
+			}
+
+			std::unique_ptr<Slot[]> m_slots;
+			std::size_t m_mask;
+			std::atomic<std::uint64_t> m_writeIndex{ 0 };
+		};
+
+		inline void WriteJsonString(std::ostream& os, std::string_view str)
+		{
+			os << '"';
+			for (const char ch : str)
+			{
+				switch (ch)
+				{
+				case '"':
+					os << "\\\"";
+					break;
+				case '\\':
+					os << "\\\\";
+					break;
+				case '\n':
+					os << "\\n";
+					break;
+				default:
+					if (static_cast<unsigned char>(ch) < 0x20)
+					{
+						constexpr char Digits[] = "0123456789abcdef";
+						os << "\\u00" << Digits[(ch >> 4) & 0xF] << Digits[ch & 0xF];
+					}
+					else
+					{
+						os << ch;
+					}
+					break;
+				}
+			}
+			os << '"';
+		}
+	}
+
+	inline constexpr bool Tracing::IsEnabled() noexcept
+	{
+# if defined(CRA_ENABLE_TRACING)
+		return true;
+# else
+		return false;
+# endif
+	}
+
+	inline void Tracing::Reset(std::size_t capacity)
+	{
+		detail::TraceBuffer::Reset(capacity);
+	}
+
+	inline std::vector<TraceEvent> Tracing::Snapshot()
+	{
+		return detail::TraceBuffer::Instance().snapshot();
+	}
+
+	inline void Tracing::WriteChromeTrace(std::ostream& os)
+	{
+		const auto events = Snapshot();
+		const auto origin = events.empty() ? std::chrono::steady_clock::time_point{} : events.front().time;
+		const auto micros = [](std::chrono::steady_clock::duration d) { return std::chrono::duration<double, std::micro>{ d }.count(); };
+		os << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+		bool first = true;
+		for (const auto& event : events)
+		{
+			os << (first ? "\n" : ",\n");
+			first = false;
+			os << "{\"pid\": 1, \"tid\": " << event.threadId << ", \"ts\": " << micros(event.time - origin) << ", \"name\": ";
+			if (event.type == TraceEventType::Run)
+			{
+				// 名前のないタスクは ID で表す
+				if (event.taskName)
+				{
+					detail::WriteJsonString(os, event.taskName);
+				}
+				else
+				{
+					os << "\"task " << event.taskId << '"';
+				}
+				os << ", \"cat\": \"task\", \"ph\": \"X\", \"dur\": " << micros(event.duration);
+			}
+			else if (event.type == TraceEventType::Push)
+			{
+				// 実行待ちのタスクの数はカウンタとして表示する
+				os << "\"ready tasks\", \"ph\": \"C\", \"args\": {\"count\": " << event.queueDepth << "}}";
+				continue;
+			}
+			else
+			{
+				constexpr const char* Names[] = { "push", "run", "sleep", "wake", "wait", "complete" };
+				os << '"' << Names[static_cast<std::size_t>(event.type)] << "\", \"cat\": \"scheduler\", \"ph\": \"i\", \"s\": \"t\"";
+			}
+			os << ", \"args\": {\"task\": " << event.taskId;
+			if (event.taskName)
+			{
+				os << ", \"name\": ";
+				detail::WriteJsonString(os, event.taskName);
+			}
+			if (event.type == TraceEventType::Sleep)
+			{
+				os << ", \"sleep_us\": " << micros(event.duration);
+			}
+			else if (event.type == TraceEventType::Wake)
+			{
+				os << ", \"slip_us\": " << micros(event.duration);
+			}
+			os << "}}";
+		}
+		os << "\n]}\n";
+	}
+}
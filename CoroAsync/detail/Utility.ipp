@@ -4,6 +4,54 @@ namespace cra
 {
 	namespace detail
 	{
+		// 複数のタスクのうち count 個が完了するまで待つ awaiter
+		// records の先頭 recordCount 個には、未完了のタスクが target に設定されている
+		class WaitTasksAwaiter
+		{
+		public:
+			WaitTasksAwaiter(WaitRecord* records, std::size_t recordCount, std::uint32_t count) noexcept
+				: m_records{ records }, m_recordCount{ recordCount }, m_count{ count } {}
+			bool await_ready() const noexcept
+			{
+				return m_count == 0;
+			}
+			template <class Promise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				return TaskQueueImpl::Wait(h.promise(), m_records, m_recordCount, m_count);
+			}
+			void await_resume() const noexcept {}
+
+		private:
+			WaitRecord* m_records;
+			std::size_t m_recordCount;
+			std::uint32_t m_count;
+		};
+
+		// 未完了のタスクを records の先頭に詰め、その数を返す
+		template <class Records, class Tasks>
+		std::size_t FillWaitRecords(Records& records, Tasks&& tasks) noexcept
+		{
+			std::size_t count = 0;
+			for (auto&& task : tasks)
+			{
+				if (auto node = PromiseBase::GetNode(task); node && not TaskQueueImpl::IsDone(*node))
+				{
+					records[count++].target = node;
+				}
+			}
+			return count;
+		}
+
+		template <class... Types>
+		std::size_t FillWaitRecords(std::array<WaitRecord, sizeof...(Types)>& records, Task<Types>&... tasks) noexcept
+		{
+			std::size_t count = 0;
+			((PromiseBase::GetNode(tasks) && not TaskQueueImpl::IsDone(*PromiseBase::GetNode(tasks))
+				? void(records[count++].target = PromiseBase::GetNode(tasks)) : void()), ...);
+			return count;
+		}
+
 		auto GetAll()
 		{
 			return std::tuple<>{};
@@ -35,35 +83,103 @@ namespace cra
 			}
 			return GetAny<Ret, I + 1>(std::forward<Tasks>(tasks)...);
 		}
+
+		// 指定した時間が経過したら target をキャンセルするタスク
+		// 先に破棄されれば、スリープの待ち行列から外されるのでキャンセルしない
+		inline Task<> CancelAfter(TaskNode& target, TaskQueue::Clock::duration timeout)
+		{
+			co_await timeout;
+			TaskQueueImpl::Cancel(target);
+		}
 	}
 
 	template <class... Types>
 	Task<detail::WhenAllResult_t<Types...>> WhenAll(Task<Types>... tasks)
 	{
-		while ((not tasks.isReady() || ...))
-		{
-			co_await 0;
-		}
+		// 最後のタスクが完了したときに1度だけ再開される
+		std::array<detail::WaitRecord, sizeof...(Types)> records{};
+		const auto pending = detail::FillWaitRecords(records, tasks...);
+		co_await detail::WaitTasksAwaiter{ records.data(), pending, static_cast<std::uint32_t>(pending) };
 		co_return detail::GetAll(tasks...);
 	}
 
 	template <class... Types>
 	Task<std::variant<Task<Types>&...>> WhenAny(Task<Types>&... tasks)
 	{
-		while ((not tasks.isReady() && ...))
-		{
-			co_await 0;
-		}
+		// 最初のタスクが完了したときに1度だけ再開される
+		std::array<detail::WaitRecord, sizeof...(Types)> records{};
+		const auto pending = detail::FillWaitRecords(records, tasks...);
+		co_await detail::WaitTasksAwaiter{ records.data(), pending, (pending == sizeof...(Types)) ? 1u : 0u };
 		co_return detail::GetAny<std::variant<Task<Types>...>>(tasks...);
 	}
 
 	template <class... Types>
 	Task<std::variant<Task<Types>...>> WhenAny(Task<Types>... tasks)
 	{
-		while ((not tasks.isReady() && ...))
+		std::array<detail::WaitRecord, sizeof...(Types)> records{};
+		const auto pending = detail::FillWaitRecords(records, tasks...);
+		co_await detail::WaitTasksAwaiter{ records.data(), pending, (pending == sizeof...(Types)) ? 1u : 0u };
+		co_return detail::GetAny<std::variant<Task<Types>...>>(std::move(tasks)...);
+	}
+
+	template <class Type>
+	Task<detail::WhenAllRangeResult_t<Type>> WhenAll(std::vector<Task<Type>> tasks)
+	{
+		std::vector<detail::WaitRecord> records(tasks.size());
+		const auto pending = detail::FillWaitRecords(records, tasks);
+		co_await detail::WaitTasksAwaiter{ records.data(), pending, static_cast<std::uint32_t>(pending) };
+		if constexpr (std::is_void_v<Type>)
 		{
-			co_await 0;
+			for (auto&& task : tasks)
+			{
+				task.get();
+			}
 		}
-		co_return detail::GetAny<std::variant<Task<Types>...>>(std::move(tasks)...);
+		else
+		{
+			std::vector<Type> results;
+			results.reserve(tasks.size());
+			for (auto&& task : tasks)
+			{
+				results.push_back(task.get());
+			}
+			co_return results;
+		}
+	}
+
+	template <std::ranges::forward_range Range>
+		requires detail::IsTask<std::ranges::range_value_t<Range>>::value
+	Task<std::size_t> WhenAny(Range& tasks)
+	{
+		// 空の範囲では完了するタスクがないので待たない
+		if (std::ranges::empty(tasks))
+		{
+			co_return 0;
+		}
+		std::vector<detail::WaitRecord> records(static_cast<std::size_t>(std::ranges::distance(tasks)));
+		const auto pending = detail::FillWaitRecords(records, tasks);
+		co_await detail::WaitTasksAwaiter{ records.data(), pending, (pending == records.size()) ? 1u : 0u };
+		std::size_t index = 0;
+		for (auto&& task : tasks)
+		{
+			if (task.isReady())
+			{
+				break;
+			}
+			++index;
+		}
+		co_return index;
+	}
+
+	template <class Type, class Rep, class Period>
+	Task<Type> WithTimeout(Task<Type> task, std::chrono::duration<Rep, Period> timeout)
+	{
+		if (auto node = detail::PromiseBase::GetNode(task))
+		{
+			// timer は task より先に破棄される
+			auto timer = detail::CancelAfter(*node, std::chrono::ceil<TaskQueue::Clock::duration>(timeout));
+			co_return co_await std::move(task);
+		}
+		co_return co_await std::move(task);
 	}
 }
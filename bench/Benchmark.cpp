@@ -0,0 +1,721 @@
+﻿# include <iostream>
+# include <chrono>
+# include <string>
+# include <string_view>
+# include <vector>
+# include <array>
+# include <span>
+# include <utility>
+# include <algorithm>
+# include <initializer_list>
+# include <atomic>
+# include <thread>
+# include <new>
+# include <cstdlib>
+# include <cstdint>
+# if defined(__linux__)
+#	include <sys/resource.h>
+#	include <netinet/in.h>
+#	include <netinet/tcp.h>
+#	include <arpa/inet.h>
+# endif
+# include "../CoroAsync/Task.hpp"
+# include "../CoroAsync/EagerTask.hpp"
+# include "../CoroAsync/Interval.hpp"
+# include "../CoroAsync/Algorithm.hpp"
+# include "../CoroAsync/Channel.hpp"
+# include "../CoroAsync/ThreadPoolExecutor.hpp"
+# include "../CoroAsync/Utility.hpp"
+# if defined(__linux__)
+#	include "../CoroAsync/Io.hpp"
+# endif
+
+// CoroAsync のマイクロベンチマーク
+// 結果は1行に1つの JSON オブジェクトとして標準出力に書き出す
+// 1回の操作あたりの時間と、グローバルな operator new の呼び出し回数、その時点でのプロセスの最大常駐セットサイズを記録する
+
+namespace
+{
+	// グローバルな operator new の呼び出し回数
+	std::atomic<std::uint64_t> allocationCount{ 0 };
+}
+
+// GCC はインライン展開された std::malloc と std::free を operator new と operator delete に対応しない確保と解放とみなして警告するので、インライン展開させない
+# if defined(__GNUC__)
+[[gnu::noinline]]
+# endif
+void* operator new(std::size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1))
+	{
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+
+# if defined(__GNUC__)
+[[gnu::noinline]]
+# endif
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+# if defined(__GNUC__)
+[[gnu::noinline]]
+# endif
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// プロセスの最大常駐セットサイズ（KiB）。取得できない環境では 0
+	long PeakRssKiB() noexcept
+	{
+# if defined(__linux__)
+		rusage usage{};
+		::getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+# else
+		return 0;
+# endif
+	}
+
+	// extra は、ケースごとに追加で書き出す値の名前と値
+	void Report(std::string_view name, std::string_view config, std::uint64_t ops, Clock::duration elapsed, std::uint64_t allocations,
+		std::initializer_list<std::pair<std::string_view, double>> extra = {})
+	{
+		const double ns = std::chrono::duration<double, std::nano>{ elapsed }.count();
+		std::cout << "{\"name\": \"" << name << "\", \"config\": \"" << config << "\", \"ops\": " << ops
+			<< ", \"ns_per_op\": " << (ns / static_cast<double>(ops))
+			<< ", \"allocs_per_op\": " << (static_cast<double>(allocations) / static_cast<double>(ops));
+		for (const auto& [key, value] : extra)
+		{
+			std::cout << ", \"" << key << "\": " << value;
+		}
+		std::cout << ", \"peak_rss_kib\": " << PeakRssKiB() << "}\n";
+	}
+
+	// function の実行にかかった時間と、その間の operator new の呼び出し回数を記録する
+	template <class Function>
+	void Measure(std::string_view name, std::string_view config, std::uint64_t ops, Function&& function)
+	{
+		const auto allocations = allocationCount.load(std::memory_order_relaxed);
+		const auto start = Clock::now();
+		function();
+		const auto elapsed = (Clock::now() - start);
+		Report(name, config, ops, elapsed, allocationCount.load(std::memory_order_relaxed) - allocations);
+	}
+
+	// target が完了するまで現在のタスクキューを回す
+	template <class Type>
+	void RunUntilReady(const cra::Task<Type>& target)
+	{
+		while (not target.isReady())
+		{
+			cra::TaskQueue::RunFor(std::chrono::seconds{ 1 });
+		}
+	}
+
+	cra::Task<> Empty()
+	{
+		co_return;
+	}
+
+	// 何もしないタスクを作成して完了させ、破棄するまでの、タスク1つあたりの時間
+	void SpawnComplete()
+	{
+		constexpr std::uint64_t Count = 1'000'000;
+		std::vector<cra::Task<>> tasks;
+		tasks.reserve(Count);
+		Measure("spawn_complete", "1M_empty_tasks", Count, [&]
+		{
+			for (std::uint64_t i = 0; i < Count; ++i)
+			{
+				tasks.push_back(Empty());
+			}
+			RunUntilReady(tasks.back());
+			tasks.clear();
+		});
+	}
+
+	// 何もしないタスクを Spawn で切り離して完了させるときの、タスク1つあたりの時間
+	// 完了したタスクは、その場でコルーチンフレームが破棄される
+	void SpawnDetached()
+	{
+		constexpr std::uint64_t Count = 1'000'000;
+		const auto liveFrames = cra::TaskQueue::GetFrameStats().liveFrames;
+		Measure("spawn_detached", "1M_empty_tasks", Count, [=]
+		{
+			for (std::uint64_t i = 0; i < Count; ++i)
+			{
+				cra::Spawn(Empty());
+			}
+			while (cra::TaskQueue::GetFrameStats().liveFrames != liveFrames)
+			{
+				cra::TaskQueue::RunFor(std::chrono::seconds{ 1 });
+			}
+		});
+	}
+
+	cra::Task<std::uint64_t> LazyValue(std::uint64_t value)
+	{
+		co_return value;
+	}
+
+	cra::EagerTask<std::uint64_t> EagerValue(std::uint64_t value)
+	{
+		co_return value;
+	}
+
+	template <class Function>
+	cra::Task<std::uint64_t> SumValues(std::uint64_t count, Function function)
+	{
+		std::uint64_t sum = 0;
+		for (std::uint64_t i = 0; i < count; ++i)
+		{
+			sum += co_await function(i);
+		}
+		co_return sum;
+	}
+
+	// 中断せずに完了するタスクを co_await するときの、タスク1つあたりの時間
+	void SynchronousCompletion(std::string_view config, bool eager)
+	{
+		constexpr std::uint64_t Count = 1'000'000;
+		Measure("synchronous_completion", config, Count, [=]
+		{
+			auto sum = eager ? SumValues(Count, EagerValue) : SumValues(Count, LazyValue);
+			RunUntilReady(sum);
+		});
+	}
+
+	cra::Task<std::string> StringValue(const std::string& value)
+	{
+		co_return value;
+	}
+
+	// 中断せずに完了するタスクを作って get() で結果を受け取るときの、タスク1つあたりの時間
+	// 結果をコルーチンフレームに持つので、 std::promise / std::future のような共有状態の確保がない
+	void ResultRetrieval()
+	{
+		constexpr std::uint64_t Count = 1'000'000;
+		Measure("result_retrieval", "int", Count, []
+		{
+			for (std::uint64_t i = 0; i < Count; ++i)
+			{
+				[[maybe_unused]] const auto value = LazyValue(i).get();
+			}
+		});
+		const std::string text(64, 'x');
+		Measure("result_retrieval", "string_64", Count, [&]
+		{
+			for (std::uint64_t i = 0; i < Count; ++i)
+			{
+				[[maybe_unused]] const auto value = StringValue(text).get();
+			}
+		});
+	}
+
+	cra::Task<> Yielder(std::uint64_t count)
+	{
+		for (std::uint64_t i = 0; i < count; ++i)
+		{
+			co_await 0;
+		}
+	}
+
+	// 2つのタスクが co_await 0 で譲り合うときの、再開1回あたりの時間
+	void YieldPingPong(std::string_view config, std::uint32_t clockCheckInterval, cra::ClockMode clockMode)
+	{
+		constexpr std::uint64_t Count = 2'000'000;
+		auto& queue = cra::TaskQueue::Current();
+		queue.setClockCheckInterval(clockCheckInterval);
+		queue.setClockMode(clockMode);
+		Measure("yield_ping_pong", config, 2 * Count, []
+		{
+			auto ping = Yielder(Count);
+			auto pong = Yielder(Count);
+			RunUntilReady(ping);
+			RunUntilReady(pong);
+		});
+		queue.setClockCheckInterval(1);
+		queue.setClockMode(cra::ClockMode::Steady);
+	}
+
+	cra::Task<> Sleeper(std::uint64_t count, std::chrono::milliseconds period)
+	{
+		for (std::uint64_t i = 0; i < count; ++i)
+		{
+			co_await period;
+		}
+	}
+
+	// 終了時刻がばらばらな多数のスリープ中のタスクを、タイマーヒープで管理するときの、スリープ1回あたりの時間
+	// 実時間で待つ時間を含めないように、仮想の時刻で実行する
+	void ConcurrentSleepers()
+	{
+		constexpr std::uint64_t TaskCount = 100'000;
+		constexpr std::uint64_t Count = 10;
+		auto& queue = cra::TaskQueue::Current();
+		queue.setClockMode(cra::ClockMode::Virtual);
+		Measure("concurrent_sleepers", "100k_tasks_virtual_clock", TaskCount * Count, []
+		{
+			std::vector<cra::Task<>> sleepers;
+			sleepers.reserve(TaskCount);
+			for (std::uint64_t i = 0; i < TaskCount; ++i)
+			{
+				sleepers.push_back(Sleeper(Count, std::chrono::milliseconds{ 1 + (i * 7919) % 97 }));
+			}
+			for (const auto& sleeper : sleepers)
+			{
+				RunUntilReady(sleeper);
+			}
+		});
+		queue.setClockMode(cra::ClockMode::Steady);
+	}
+
+	// 100 ms ごとに動くタスクを、仮想の時刻で 1 時間分シミュレートするときの、再開1回あたりの時間
+	void VirtualClockTickers()
+	{
+		constexpr std::uint64_t TaskCount = 100;
+		constexpr std::uint64_t Count = 36'000;
+		auto& queue = cra::TaskQueue::Current();
+		queue.setClockMode(cra::ClockMode::Virtual);
+		Measure("virtual_clock_tickers", "100_tasks_1h", TaskCount * Count, []
+		{
+			std::vector<cra::Task<>> tickers;
+			for (std::uint64_t i = 0; i < TaskCount; ++i)
+			{
+				tickers.push_back(Sleeper(Count, std::chrono::milliseconds{ 100 }));
+			}
+			RunUntilReady(tickers.back());
+		});
+		queue.setClockMode(cra::ClockMode::Steady);
+	}
+
+	cra::Task<> IntervalTicker(cra::Interval interval, std::uint64_t count)
+	{
+		for (std::uint64_t i = 0; i < count; ++i)
+		{
+			co_await interval.next();
+		}
+	}
+
+	// 開始時刻のばらばらな 10000 個の Interval を、仮想の時刻で 10 秒分動かすときの、 tick 1回あたりの時間
+	// タイマースラックを設定すると、近い時刻の tick がまとめて実行待ちになる
+	void IntervalTickers(std::string_view config, cra::TaskQueue::Clock::duration slack)
+	{
+		constexpr std::uint64_t TaskCount = 10'000;
+		constexpr std::uint64_t Count = 100;
+		auto& queue = cra::TaskQueue::Current();
+		queue.setClockMode(cra::ClockMode::Virtual);
+		queue.setTimerSlack(slack);
+		Measure("interval_tickers", config, TaskCount * Count, [&]
+		{
+			const auto start = queue.now();
+			std::vector<cra::Task<>> tickers;
+			tickers.reserve(TaskCount);
+			for (std::uint64_t i = 0; i < TaskCount; ++i)
+			{
+				tickers.push_back(IntervalTicker(cra::Interval{ start + std::chrono::microseconds{ (i * 7919) % 100'000 }, std::chrono::milliseconds{ 100 } }, Count));
+			}
+			for (const auto& ticker : tickers)
+			{
+				RunUntilReady(ticker);
+			}
+		});
+		queue.setTimerSlack(cra::TaskQueue::Clock::duration::zero());
+		queue.setClockMode(cra::ClockMode::Steady);
+	}
+
+	cra::Task<> FrameTicker(std::uint64_t count)
+	{
+		for (std::uint64_t i = 0; i < count; ++i)
+		{
+			co_await cra::NextFrame();
+		}
+	}
+
+	// フレームごとに1回再開される 10000 個のタスクを、 100 フレーム分進めるときの、再開1回あたりの時間
+	void FrameTickers()
+	{
+		constexpr std::uint64_t TaskCount = 10'000;
+		constexpr std::uint64_t Count = 100;
+		std::vector<cra::Task<>> tickers;
+		tickers.reserve(TaskCount);
+		for (std::uint64_t i = 0; i < TaskCount; ++i)
+		{
+			tickers.push_back(FrameTicker(Count));
+		}
+		cra::TaskQueue::Current().setClockCheckInterval(static_cast<std::uint32_t>(TaskCount));
+		cra::TaskQueue::RunFor(std::chrono::seconds{ 0 });
+		cra::TaskQueue::Current().setClockCheckInterval(1);
+		Measure("next_frame", "10k_tasks_100_frames", TaskCount * Count, [&]
+		{
+			for (std::uint64_t i = 0; i < Count; ++i)
+			{
+				cra::TaskQueue::AdvanceFrame();
+			}
+		});
+	}
+
+	cra::Task<std::uint32_t> FibonacciAsync(std::uint32_t n)
+	{
+		if (n <= 1)
+		{
+			co_return n;
+		}
+		co_return co_await FibonacciAsync(n - 1) + co_await FibonacciAsync(n - 2);
+	}
+
+	// 再帰的に co_await するタスクの、タスク1つあたりの時間
+	void FibonacciChain(std::string_view config, cra::ContinuationMode mode)
+	{
+		constexpr std::uint32_t N = 25;
+		// FibonacciAsync(N) が作成するタスクの数は 2 * F(N + 1) - 1
+		constexpr std::uint64_t TaskCount = 2 * 121'393 - 1;
+		cra::TaskQueue::SetContinuationMode(mode);
+		Measure("fibonacci_await_chain", config, TaskCount, []
+		{
+			auto fib = FibonacciAsync(N);
+			RunUntilReady(fib);
+		});
+		cra::TaskQueue::SetContinuationMode(cra::ContinuationMode::Queued);
+	}
+
+	// スレッドプールのワーカーで作成されたタスクは、そのワーカーの deque に積まれ、他のワーカーに盗まれて並列に実行される
+	cra::Task<std::uint32_t> ParallelFibonacci(std::uint32_t n)
+	{
+		if (n <= 1)
+		{
+			co_return n;
+		}
+		auto a = ParallelFibonacci(n - 1);
+		auto b = ParallelFibonacci(n - 2);
+		co_return co_await a + co_await b;
+	}
+
+	cra::Task<std::uint32_t> ParallelFibonacciRoot(cra::ThreadPoolExecutor& pool, std::uint32_t n)
+	{
+		co_await pool.schedule();
+		co_return co_await ParallelFibonacci(n);
+	}
+
+	// スレッドプールで再帰的にタスクを作成して待つときの、タスク1つあたりの時間
+	// ワーカースレッドの数を 1 からハードウェアのスレッド数まで倍にしながら測る
+	void PoolScaling()
+	{
+		constexpr std::uint32_t N = 25;
+		constexpr std::uint64_t TaskCount = 2 * 121'393 - 1;
+		const auto maxThreads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+		for (std::size_t threads = 1;; threads = std::min(threads * 2, maxThreads))
+		{
+			cra::ThreadPoolExecutor pool{ threads };
+			const auto config = ("fibonacci_25_threads_" + std::to_string(threads));
+			Measure("thread_pool_scaling", config, TaskCount, [&]
+			{
+				auto fib = ParallelFibonacciRoot(pool, N);
+				fib.wait();
+			});
+			if (threads == maxThreads)
+			{
+				break;
+			}
+		}
+	}
+
+# if defined(__linux__)
+	constexpr std::size_t EchoMessageSize = 64;
+
+	cra::Task<> EchoSession(int fd)
+	{
+		std::array<std::byte, EchoMessageSize> buffer;
+		while (const auto size = co_await cra::io::Read(fd, buffer))
+		{
+			for (std::size_t written = 0; written < size;)
+			{
+				written += co_await cra::io::Write(fd, std::span{ buffer }.subspan(written, size - written));
+			}
+		}
+		::close(fd);
+	}
+
+	cra::Task<> EchoServer(int listener, std::size_t clientCount)
+	{
+		std::vector<cra::Task<>> sessions;
+		for (std::size_t i = 0; i < clientCount; ++i)
+		{
+			const int fd = co_await cra::io::Accept(listener);
+			const int noDelay = 1;
+			::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+			sessions.push_back(EchoSession(fd));
+		}
+		co_await cra::WhenAll(std::move(sessions));
+	}
+
+	// latencies の要素の数だけ、メッセージを送って同じ大きさの返信を受け取り、往復ごとの時間を書き込む
+	cra::Task<> EchoClient(std::uint16_t port, std::span<Clock::duration> latencies)
+	{
+		const int fd = ::socket(AF_INET, (SOCK_STREAM | SOCK_NONBLOCK), 0);
+		const int noDelay = 1;
+		::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+		co_await cra::io::Writable(fd);
+		std::array<std::byte, EchoMessageSize> message{};
+		std::array<std::byte, EchoMessageSize> reply;
+		for (auto& latency : latencies)
+		{
+			const auto start = Clock::now();
+			for (std::size_t written = 0; written < message.size();)
+			{
+				written += co_await cra::io::Write(fd, std::span{ message }.subspan(written));
+			}
+			for (std::size_t received = 0; received < reply.size();)
+			{
+				received += co_await cra::io::Read(fd, std::span{ reply }.subspan(received));
+			}
+			latency = (Clock::now() - start);
+		}
+		::close(fd);
+	}
+
+	// ループバックのエコーサーバーとクライアントを同じタスクキューで動かすときの、往復1回あたりの時間
+	// 1秒あたりの往復の回数と、往復の時間の中央値と 99 パーセンタイルも書き出す
+	void LoopbackEcho()
+	{
+		constexpr std::size_t ClientCount = 16;
+		constexpr std::size_t RequestCount = 2'000;
+		const int listener = ::socket(AF_INET, (SOCK_STREAM | SOCK_NONBLOCK), 0);
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t addressSize = sizeof(address);
+		if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+			|| ::listen(listener, static_cast<int>(ClientCount)) != 0
+			|| ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &addressSize) != 0)
+		{
+			::close(listener);
+			return;
+		}
+		const auto port = ntohs(address.sin_port);
+		std::vector<Clock::duration> latencies(ClientCount * RequestCount);
+		const auto allocations = allocationCount.load(std::memory_order_relaxed);
+		const auto start = Clock::now();
+		{
+			auto server = EchoServer(listener, ClientCount);
+			std::vector<cra::Task<>> clients;
+			for (std::size_t i = 0; i < ClientCount; ++i)
+			{
+				clients.push_back(EchoClient(port, std::span{ latencies }.subspan(i * RequestCount, RequestCount)));
+			}
+			auto all = cra::WhenAll(std::move(clients));
+			RunUntilReady(all);
+			RunUntilReady(server);
+		}
+		const auto elapsed = (Clock::now() - start);
+		const auto allocated = (allocationCount.load(std::memory_order_relaxed) - allocations);
+		::close(listener);
+		std::ranges::sort(latencies);
+		const auto micros = [&](double quantile)
+		{
+			const auto index = static_cast<std::size_t>(quantile * static_cast<double>(latencies.size() - 1));
+			return std::chrono::duration<double, std::micro>{ latencies[index] }.count();
+		};
+		const auto seconds = std::chrono::duration<double>{ elapsed }.count();
+		Report("loopback_echo", "16_clients_64_bytes", latencies.size(), elapsed, allocated,
+			{ { "requests_per_sec", (static_cast<double>(latencies.size()) / seconds) }, { "p50_us", micros(0.5) }, { "p99_us", micros(0.99) } });
+	}
+# endif
+
+	// 1000 個のタスクを WhenAll で待つときの、子タスク1つあたりの時間
+	void WhenAllFanIn()
+	{
+		constexpr std::uint64_t ChildCount = 1'000;
+		constexpr std::uint64_t Repeat = 1'000;
+		Measure("when_all", "1000_children", ChildCount * Repeat, []
+		{
+			for (std::uint64_t r = 0; r < Repeat; ++r)
+			{
+				std::vector<cra::Task<>> children;
+				children.reserve(ChildCount);
+				for (std::uint64_t i = 0; i < ChildCount; ++i)
+				{
+					children.push_back(Yielder(1));
+				}
+				auto all = cra::WhenAll(std::move(children));
+				RunUntilReady(all);
+			}
+		});
+	}
+
+	// 空の範囲を WhenAny で待つときの、1回あたりの時間
+	// 待つタスクがないので、中断せずに 0 を結果として完了する
+	void WhenAnyEmpty()
+	{
+		constexpr std::uint64_t Count = 100'000;
+		Measure("when_any", "empty_range", Count, []
+		{
+			std::vector<cra::Task<>> tasks;
+			for (std::uint64_t i = 0; i < Count; ++i)
+			{
+				[[maybe_unused]] const auto index = cra::WhenAny(tasks).get();
+			}
+		});
+	}
+
+	// ForEachAsync で配列の要素を処理するときの、要素1つあたりの時間
+	// budget ごとに他のタスクへ実行を譲りながら処理する
+	void ForEachElements(std::string_view config, cra::TaskQueue::Clock::duration budget)
+	{
+		constexpr std::uint64_t ElementCount = 10'000'000;
+		std::vector<std::uint32_t> values(ElementCount, 1);
+		Measure("for_each_async", config, ElementCount, [&]
+		{
+			auto task = cra::ForEachAsync(values, [](std::uint32_t& value) { value = (value * 1'664'525 + 1'013'904'223); }, budget);
+			RunUntilReady(task);
+		});
+	}
+
+	// スリープ中のタスクをまとめて破棄するときの、タスク1つあたりの時間
+	void BulkDestroy()
+	{
+		constexpr std::uint64_t TaskCount = 100'000;
+		std::vector<cra::Task<>> sleepers;
+		sleepers.reserve(TaskCount);
+		for (std::uint64_t i = 0; i < TaskCount; ++i)
+		{
+			sleepers.push_back(Sleeper(1, std::chrono::milliseconds{ 1'000'000 + i }));
+		}
+		cra::TaskQueue::RunFor(std::chrono::seconds{ 0 });
+		Measure("bulk_destroy", "100k_sleeping_tasks", TaskCount, [&]
+		{
+			sleepers.clear();
+		});
+	}
+
+	// 10 万個のスリープ中のタスクのうち 1 万個を破棄するときの、タスク1つあたりの時間
+	// 残りのタスクが多いままタイマーヒープの途中から取り除くので、 bulk_destroy より削除が重い
+	void SparseDestroy()
+	{
+		constexpr std::uint64_t TaskCount = 100'000;
+		constexpr std::uint64_t Stride = 10;
+		std::vector<cra::Task<>> sleepers;
+		sleepers.reserve(TaskCount);
+		for (std::uint64_t i = 0; i < TaskCount; ++i)
+		{
+			sleepers.push_back(Sleeper(1, std::chrono::milliseconds{ 1'000'000 + i }));
+		}
+		cra::TaskQueue::RunFor(std::chrono::seconds{ 0 });
+		Measure("sparse_destroy", "10k_of_100k_sleeping_tasks", TaskCount / Stride, [&]
+		{
+			for (std::uint64_t i = 0; i < TaskCount; i += Stride)
+			{
+				sleepers[i] = cra::Task<>{};
+			}
+		});
+	}
+
+	cra::Task<> CancelableSleeper(cra::CancellationToken token)
+	{
+		co_await cra::SetCancellationToken(std::move(token));
+		co_await std::chrono::hours{ 1 };
+	}
+
+	// スリープ中のタスクをまとめてキャンセルし、 OperationCanceled で終了させるときの、タスク1つあたりの時間
+	void CancelSleepers()
+	{
+		constexpr std::uint64_t TaskCount = 100'000;
+		cra::CancellationSource source;
+		std::vector<cra::Task<>> sleepers;
+		sleepers.reserve(TaskCount);
+		for (std::uint64_t i = 0; i < TaskCount; ++i)
+		{
+			sleepers.push_back(CancelableSleeper(source.token()));
+		}
+		cra::TaskQueue::RunFor(std::chrono::seconds{ 0 });
+		Measure("cancel_sleepers", "100k_sleeping_tasks", TaskCount, [&]
+		{
+			source.cancel();
+			RunUntilReady(sleepers.back());
+			sleepers.clear();
+		});
+	}
+
+	cra::Task<std::size_t> CancelableReceiveMany(cra::Channel<std::uint64_t>& channel, cra::CancellationToken token)
+	{
+		co_await cra::SetCancellationToken(std::move(token));
+		std::array<std::uint64_t, 4> values{};
+		co_return co_await channel.receiveMany(values);
+	}
+
+	cra::Task<> SendAndCancel(cra::Channel<std::uint64_t>& channel, cra::CancellationSource& source, std::uint64_t value)
+	{
+		co_await channel.send(value);
+		source.cancel();
+	}
+
+	cra::Task<std::uint64_t> ReceiveOne(cra::Channel<std::uint64_t>& channel)
+	{
+		co_return *(co_await channel.receive());
+	}
+
+	// receiveMany で待っているタスクに値を渡した直後にキャンセルし、戻された値を別のタスクが受け取るまでの、1回あたりの時間
+	void CancelReceiveMany()
+	{
+		constexpr std::uint64_t Count = 100'000;
+		cra::Channel<std::uint64_t> channel{ 0 };
+		Measure("channel_cancel", "receive_many_after_send", Count, [&]
+		{
+			for (std::uint64_t i = 0; i < Count; ++i)
+			{
+				cra::CancellationSource source;
+				auto receiver = CancelableReceiveMany(channel, source.token());
+				auto sender = SendAndCancel(channel, source, i);
+				// 値が失われていれば、ここで完了しなくなる
+				auto next = ReceiveOne(channel);
+				RunUntilReady(next);
+			}
+		});
+	}
+}
+
+int main()
+{
+	SpawnComplete();
+	SpawnDetached();
+	SynchronousCompletion("lazy_task", false);
+	SynchronousCompletion("eager_task", true);
+	ResultRetrieval();
+	YieldPingPong("per_resume_clock", 1, cra::ClockMode::Steady);
+	YieldPingPong("batch_64", 64, cra::ClockMode::Steady);
+	YieldPingPong("batch_64_coarse", 64, cra::ClockMode::Coarse);
+	ConcurrentSleepers();
+	VirtualClockTickers();
+	IntervalTickers("10k_tasks_no_slack", std::chrono::milliseconds{ 0 });
+	IntervalTickers("10k_tasks_slack_10ms", std::chrono::milliseconds{ 10 });
+	FrameTickers();
+	FibonacciChain("queued", cra::ContinuationMode::Queued);
+	FibonacciChain("eager", cra::ContinuationMode::Eager);
+	WhenAllFanIn();
+	WhenAnyEmpty();
+	PoolScaling();
+# if defined(__linux__)
+	LoopbackEcho();
+# endif
+	ForEachElements("10m_elements_budget_1ms", std::chrono::milliseconds{ 1 });
+	ForEachElements("10m_elements_budget_100us", std::chrono::microseconds{ 100 });
+	BulkDestroy();
+	SparseDestroy();
+	CancelSleepers();
+	CancelReceiveMany();
+}